@@ -0,0 +1,134 @@
+//========================================================//
+//  bench_parse.cpp                                       //
+//  Microbenchmark for the text trace parser              //
+//                                                        //
+//  Parses an in-memory text trace with the old getline   //
+//  plus sscanf path and with every parse_lines() kernel  //
+//  the CPU supports, checks they agree and reports       //
+//  lines per second                                      //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "trace.h"
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Fold a record into a running checksum
+static uint64_t mix(uint64_t sum, const trace_record *rec)
+{
+  return (sum * 1000003) ^ ((uint64_t)rec->pc << 32 | rec->target) ^ rec->flags;
+}
+
+// The read_branch() path this parser replaces
+//
+static uint64_t bench_sscanf(char *text, size_t size, uint64_t *lines)
+{
+  FILE *stream = fmemopen(text, size, "r");
+  char *buf = NULL;
+  size_t len = 0;
+  uint64_t sum = 0;
+  *lines = 0;
+  while (getline(&buf, &len, stream) != -1)
+  {
+    uint32_t pc, target, outcome, condition, call, ret, direct;
+    sscanf(buf, "0x%x\t0x%x\t%d\t%d\t%d\t%d\t%d\n", &pc, &target, &outcome, &condition, &call, &ret, &direct);
+    trace_record rec;
+    rec.pc = pc;
+    rec.target = target;
+    rec.flags = trace_pack_flags(outcome, condition, call, ret, direct);
+    sum = mix(sum, &rec);
+    (*lines)++;
+  }
+  free(buf);
+  fclose(stream);
+  return sum;
+}
+
+static uint64_t bench_kernel(const char *text, size_t size, uint64_t *lines)
+{
+  static branch_batch batch;
+  parse_stats stats;
+  memset(&stats, 0, sizeof(stats));
+  const char *pos = text;
+  uint64_t sum = 0;
+  do
+  {
+    batch.count = 0;
+    parse_lines(&pos, text + size, &batch, &stats);
+    for (size_t i = 0; i < batch.count; i++)
+    {
+      trace_record rec;
+      rec.pc = batch.pc[i];
+      rec.target = batch.target[i];
+      rec.flags = batch.flags[i];
+      sum = mix(sum, &rec);
+    }
+  } while (batch.count > 0);
+  *lines = stats.lines;
+  if (stats.malformed > 0)
+  {
+    printf("  %llu malformed lines, first at line %llu\n",
+           (unsigned long long)stats.malformed, (unsigned long long)stats.first_malformed);
+  }
+  return sum;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc != 2)
+  {
+    fprintf(stderr, "Usage: bench_parse <text trace>\n");
+    exit(1);
+  }
+
+  FILE *f = fopen(argv[1], "rb");
+  if (f == NULL)
+  {
+    fprintf(stderr, "Unable to open %s\n", argv[1]);
+    exit(1);
+  }
+  fseek(f, 0, SEEK_END);
+  size_t size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  char *text = (char *)malloc(size + PARSE_PAD);
+  if (fread(text, 1, size, f) != size)
+  {
+    fprintf(stderr, "Unable to read %s\n", argv[1]);
+    exit(1);
+  }
+  fclose(f);
+
+  uint64_t lines;
+  double t0 = now();
+  uint64_t ref = bench_sscanf(text, size, &lines);
+  double base = lines / (now() - t0);
+  printf("%-8s %12.0f lines/s\n", "sscanf", base);
+
+  int status = 0;
+  for (int k = PARSE_SCALAR; k <= PARSE_AVX2; k++)
+  {
+    if (parse_select(k) != k)
+    {
+      printf("%-8s unsupported\n", parseKernelName[k]);
+      continue;
+    }
+    uint64_t klines;
+    t0 = now();
+    uint64_t sum = bench_kernel(text, size, &klines);
+    double rate = klines / (now() - t0);
+    int same = sum == ref && klines == lines;
+    printf("%-8s %12.0f lines/s  %6.1fx  %s\n", parseKernelName[k], rate, rate / base,
+           same ? "matches sscanf" : "MISMATCH");
+    status |= !same;
+  }
+
+  free(text);
+  return status;
+}
@@ -0,0 +1,49 @@
+//========================================================//
+//  counter.h                                             //
+//  Saturating counters                                   //
+//                                                        //
+//  An n-bit counter counts 0 to 2^n-1 and predicts taken //
+//  in its upper half, so the SN..ST and NNN..TTT states  //
+//  are its values. Updates saturate with arithmetic on   //
+//  comparison results instead of switching on the state  //
+//========================================================//
+
+#ifndef COUNTER_H
+#define COUNTER_H
+
+#include <stdint.h>
+
+template <int Bits>
+struct SatCounter {
+  static_assert(Bits >= 1 && Bits <= 8, "SatCounter holds 1 to 8 bits");
+
+  static constexpr uint8_t min = 0;
+  static constexpr uint8_t max = (1U << Bits) - 1;
+
+  uint8_t value;
+
+  // Prediction of the counter, TAKEN in its upper half
+  uint8_t predict() const
+  {
+    return value >> (Bits - 1);
+  }
+
+  void inc()
+  {
+    value += value < max;
+  }
+
+  void dec()
+  {
+    value -= value > min;
+  }
+
+  // Count towards 'outcome', TAKEN counting up
+  void update(uint32_t outcome)
+  {
+    uint8_t up = outcome != 0;
+    value += (up & (value < max)) - (!up & (value > min));
+  }
+};
+
+#endif
@@ -0,0 +1,437 @@
+//========================================================//
+//  dse.cpp                                               //
+//  Source file for the TAGE design-space exploration     //
+//                                                        //
+//  Candidates are genomes of table counts, widths, a     //
+//  geometric history series and the useful bit decay     //
+//  period. Only genomes within the budget are built.     //
+//  Each generation keeps the better half and refills     //
+//  the population with mutated crossovers of it          //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dse.h"
+#include "tage.h"
+
+//------------------------------------//
+//           Search Space             //
+//------------------------------------//
+
+#define DSE_MIN_TABLES 2
+#define DSE_MIN_BITS 6
+#define DSE_MAX_BASE_BITS 16
+#define DSE_MAX_TABLE_BITS 12
+#define DSE_MAX_TAG_BITS 16  // widest tag hash, of which TAGE keeps 8 bits
+#define DSE_MIN_U_DECAY 16000
+#define DSE_MAX_U_DECAY 4096000
+#define DSE_TRIES 200  // draws for a feasible, unseen candidate
+#define DSE_LEADERS 10 // candidates listed at the end
+
+struct dse_genome {
+  int num_tables;
+  int base_bits;
+  int table_bits;
+  int tag_bits;
+  int min_hist;
+  int max_hist;
+  int u_decay;
+};
+
+struct dse_candidate {
+  dse_genome genome;
+  tage_geometry geometry;
+  char key[192]; // the geometry as --custom parameters
+  int64_t bits;
+  double rate;   // mean mispredictions per 1000 branches
+};
+
+// splitmix64, so a seed gives the same search everywhere
+static uint64_t dse_next(uint64_t *state)
+{
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static int dse_uniform(uint64_t *state, int lo, int hi)
+{
+  return lo + (int)(dse_next(state) % (uint64_t)(hi - lo + 1));
+}
+
+static int dse_clamp(int v, int lo, int hi)
+{
+  return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// Longest history a genome may ask for, leaving room for the
+// lengths to be pushed apart
+static int dse_max_hist(int num_tables)
+{
+  return TAGE_MAX_HIST_LEN - num_tables;
+}
+
+static void dse_format_key(dse_candidate *c)
+{
+  const tage_geometry *g = &c->geometry;
+  int n = snprintf(c->key, sizeof(c->key), "tables=%d,hist=%d,base=%d,index=%d,tag=%d,udecay=%d,lens=", g->num_tables,
+                   g->hist_len, g->base_bits, g->table_bits, g->tag_bits, g->u_decay);
+  for (int i = 0; i < g->num_tables; i++)
+  {
+    n += snprintf(c->key + n, sizeof(c->key) - n, i == 0 ? "%d" : "/%d", g->table_hist_len[i]);
+  }
+}
+
+static void dse_set_geometry(dse_candidate *c, const tage_geometry *g)
+{
+  c->geometry = *g;
+  tage_canonical_lengths(&c->geometry);
+  c->bits = tage_storage_bits(*g);
+  c->rate = 0;
+  dse_format_key(c);
+}
+
+// Build the candidate of genome 'gn'
+static void dse_build(dse_candidate *c, const dse_genome *gn)
+{
+  tage_geometry g;
+  memset(&g, 0, sizeof(g));
+  g.num_tables = gn->num_tables;
+  g.base_bits = gn->base_bits;
+  g.table_bits = gn->table_bits;
+  g.tag_bits = gn->tag_bits;
+  g.u_decay = gn->u_decay;
+  geometric_history_lengths(gn->num_tables, gn->min_hist, gn->max_hist, g.table_hist_len);
+  g.hist_len = g.table_hist_len[gn->num_tables - 1];
+  c->genome = *gn;
+  dse_set_geometry(c, &g);
+}
+
+static void dse_random_genome(uint64_t *rng, dse_genome *gn)
+{
+  gn->num_tables = dse_uniform(rng, DSE_MIN_TABLES, TAGE_MAX_TABLES);
+  gn->base_bits = dse_uniform(rng, DSE_MIN_BITS + 4, DSE_MAX_BASE_BITS);
+  gn->table_bits = dse_uniform(rng, DSE_MIN_BITS, DSE_MAX_TABLE_BITS);
+  gn->tag_bits = dse_uniform(rng, DSE_MIN_BITS, DSE_MAX_TAG_BITS);
+  gn->min_hist = dse_uniform(rng, 1, 8);
+  gn->max_hist = dse_clamp(16 << dse_uniform(rng, 0, 7), gn->min_hist * 2, dse_max_hist(gn->num_tables));
+  gn->u_decay = 64000 << dse_uniform(rng, 0, 4);
+}
+
+// Change one gene of 'gn' by a step either way
+static void dse_mutate(uint64_t *rng, dse_genome *gn)
+{
+  int up = dse_uniform(rng, 0, 1);
+  int step = up ? 1 : -1;
+  switch (dse_uniform(rng, 0, 6))
+  {
+  case 0:
+    gn->num_tables = dse_clamp(gn->num_tables + step, DSE_MIN_TABLES, TAGE_MAX_TABLES);
+    break;
+  case 1:
+    gn->base_bits = dse_clamp(gn->base_bits + step, DSE_MIN_BITS, DSE_MAX_BASE_BITS);
+    break;
+  case 2:
+    gn->table_bits = dse_clamp(gn->table_bits + step, DSE_MIN_BITS, DSE_MAX_TABLE_BITS);
+    break;
+  case 3:
+    gn->tag_bits = dse_clamp(gn->tag_bits + step, DSE_MIN_BITS, DSE_MAX_TAG_BITS);
+    break;
+  case 4:
+    gn->min_hist = up ? gn->min_hist * 3 / 2 + 1 : gn->min_hist * 2 / 3;
+    break;
+  case 5:
+    gn->max_hist = up ? gn->max_hist * 4 / 3 : gn->max_hist * 3 / 4;
+    break;
+  case 6:
+    gn->u_decay = dse_clamp(up ? gn->u_decay * 2 : gn->u_decay / 2, DSE_MIN_U_DECAY, DSE_MAX_U_DECAY);
+    break;
+  }
+  gn->max_hist = dse_clamp(gn->max_hist, 2, dse_max_hist(gn->num_tables));
+  gn->min_hist = dse_clamp(gn->min_hist, 1, gn->max_hist / 2);
+}
+
+// Take each gene from 'a' or 'b' at random
+static void dse_crossover(uint64_t *rng, const dse_genome *a, const dse_genome *b, dse_genome *child)
+{
+  uint64_t pick = dse_next(rng);
+  child->num_tables = (pick & 1) ? a->num_tables : b->num_tables;
+  child->base_bits = (pick & 2) ? a->base_bits : b->base_bits;
+  child->table_bits = (pick & 4) ? a->table_bits : b->table_bits;
+  child->tag_bits = (pick & 8) ? a->tag_bits : b->tag_bits;
+  child->min_hist = (pick & 16) ? a->min_hist : b->min_hist;
+  child->max_hist = (pick & 32) ? a->max_hist : b->max_hist;
+  child->u_decay = (pick & 64) ? a->u_decay : b->u_decay;
+  child->max_hist = dse_clamp(child->max_hist, 2, dse_max_hist(child->num_tables));
+  child->min_hist = dse_clamp(child->min_hist, 1, child->max_hist / 2);
+}
+
+//------------------------------------//
+//         Results Database           //
+//------------------------------------//
+
+// One line per simulated (candidate, trace) pair, tab separated:
+//   <key> <trace> <branches> <mispredictions>
+struct dse_entry {
+  char *key;
+  char *trace;
+  sim_result result;
+};
+
+struct dse_db {
+  FILE *out;
+  dse_entry *entries;
+  int count;
+  int capacity;
+};
+
+static void dse_db_insert(dse_db *db, const char *key, const char *trace, const sim_result *r)
+{
+  if (db->count == db->capacity)
+  {
+    db->capacity = db->capacity ? db->capacity * 2 : 256;
+    db->entries = (dse_entry *)realloc(db->entries, db->capacity * sizeof(dse_entry));
+  }
+  dse_entry *e = &db->entries[db->count++];
+  e->key = strdup(key);
+  e->trace = strdup(trace);
+  e->result = *r;
+}
+
+static const sim_result *dse_db_find(const dse_db *db, const char *key, const char *trace)
+{
+  for (int i = 0; i < db->count; i++)
+  {
+    if (!strcmp(db->entries[i].key, key) && !strcmp(db->entries[i].trace, trace))
+    {
+      return &db->entries[i].result;
+    }
+  }
+  return NULL;
+}
+
+// Load the results at 'path' and open it to append new ones
+//
+// Returns True if Successful
+//
+static int dse_db_open(dse_db *db, const char *path)
+{
+  memset(db, 0, sizeof(*db));
+  FILE *in = fopen(path, "r");
+  if (in != NULL)
+  {
+    char line[1024];
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+      if (line[0] == '#')
+      {
+        continue;
+      }
+      char *key = strtok(line, "\t\n");
+      char *trace = strtok(NULL, "\t\n");
+      char *branches = strtok(NULL, "\t\n");
+      char *mispredictions = strtok(NULL, "\t\n");
+      if (mispredictions != NULL)
+      {
+        sim_result r;
+        r.num_branches = strtoul(branches, NULL, 10);
+        r.mispredictions = strtoul(mispredictions, NULL, 10);
+        dse_db_insert(db, key, trace, &r);
+      }
+    }
+    fclose(in);
+  }
+
+  db->out = fopen(path, "a");
+  if (db->out == NULL)
+  {
+    return 0;
+  }
+  if (ftell(db->out) == 0)
+  {
+    fprintf(db->out, "# key\ttrace\tbranches\tmispredictions\n");
+  }
+  return 1;
+}
+
+static void dse_db_add(dse_db *db, const char *key, const char *trace, const sim_result *r)
+{
+  dse_db_insert(db, key, trace, r);
+  fprintf(db->out, "%s\t%s\t%u\t%u\n", key, trace, r->num_branches, r->mispredictions);
+}
+
+static void dse_db_close(dse_db *db)
+{
+  fclose(db->out);
+  for (int i = 0; i < db->count; i++)
+  {
+    free(db->entries[i].key);
+    free(db->entries[i].trace);
+  }
+  free(db->entries);
+}
+
+//------------------------------------//
+//             Search                 //
+//------------------------------------//
+
+// Score every candidate on every trace, simulating on the sweep
+// pool only the pairs the database does not have
+static int dse_evaluate(const dse_options *opt, dse_db *db, dse_candidate *cands, int n, const sweep_trace *traces,
+                        int num_traces)
+{
+  sweep_job *jobs = (sweep_job *)calloc(n * num_traces, sizeof(sweep_job));
+  int *job_cand = (int *)malloc(n * num_traces * sizeof(int));
+  int num_jobs = 0;
+  for (int c = 0; c < n; c++)
+  {
+    for (int t = 0; t < num_traces; t++)
+    {
+      if (dse_db_find(db, cands[c].key, traces[t].path) == NULL)
+      {
+        jobs[num_jobs].trace = &traces[t];
+        default_spec(&jobs[num_jobs].spec, CUSTOM);
+        jobs[num_jobs].spec.tage = cands[c].geometry;
+        job_cand[num_jobs++] = c;
+      }
+    }
+  }
+  if (num_jobs > 0)
+  {
+    sweep_run(jobs, num_jobs, opt->threads);
+  }
+  for (int j = 0; j < num_jobs; j++)
+  {
+    dse_db_add(db, cands[job_cand[j]].key, jobs[j].trace->path, &jobs[j].result);
+  }
+  fflush(db->out);
+
+  for (int c = 0; c < n; c++)
+  {
+    double sum = 0;
+    for (int t = 0; t < num_traces; t++)
+    {
+      const sim_result *r = dse_db_find(db, cands[c].key, traces[t].path);
+      sum += r->num_branches ? 1000.0 * r->mispredictions / r->num_branches : 0;
+    }
+    cands[c].rate = sum / num_traces;
+  }
+  free(jobs);
+  free(job_cand);
+  return num_jobs;
+}
+
+static int dse_compare(const void *a, const void *b)
+{
+  double ra = ((const dse_candidate *)a)->rate;
+  double rb = ((const dse_candidate *)b)->rate;
+  return ra < rb ? -1 : (ra > rb ? 1 : 0);
+}
+
+static int dse_seen(const dse_candidate *archive, int n, const char *key)
+{
+  for (int i = 0; i < n; i++)
+  {
+    if (!strcmp(archive[i].key, key))
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void dse_run(const dse_options *opt, const sweep_trace *traces, int num_traces)
+{
+  dse_db db;
+  if (!dse_db_open(&db, opt->db_path))
+  {
+    fprintf(stderr, "Unable to open results database %s\n", opt->db_path);
+    exit(1);
+  }
+
+  uint64_t rng = opt->seed;
+  int pop = opt->population;
+  dse_candidate *cands = (dse_candidate *)calloc(pop, sizeof(dse_candidate));
+  dse_candidate *archive = (dse_candidate *)calloc(pop * opt->generations, sizeof(dse_candidate));
+  int num_archived = 0;
+
+  // The first generation starts from the registered configurations
+  // that fit, then random genomes
+  int n = 0;
+  for (int i = 0; i < num_tage_variants && n < pop; i++)
+  {
+    const tage_geometry *g = &tage_variants[i].geometry;
+    if (tage_storage_bits(*g) <= opt->budget)
+    {
+      dse_genome gn = {g->num_tables, g->base_bits, g->table_bits, g->tag_bits, g->table_hist_len[0],
+                       g->table_hist_len[g->num_tables - 1], g->u_decay};
+      cands[n].genome = gn;
+      dse_set_geometry(&cands[n], g);
+      n++;
+    }
+  }
+  for (int tries = 0; n < pop && tries < pop * DSE_TRIES; tries++)
+  {
+    dse_genome gn;
+    dse_random_genome(&rng, &gn);
+    dse_build(&cands[n], &gn);
+    if (cands[n].bits <= opt->budget && !dse_seen(cands, n, cands[n].key))
+    {
+      n++;
+    }
+  }
+
+  for (int gen = 0; gen < opt->generations && n > 0; gen++)
+  {
+    int simulated = dse_evaluate(opt, &db, cands, n, traces, num_traces);
+    for (int c = 0; c < n; c++)
+    {
+      if (!dse_seen(archive, num_archived, cands[c].key))
+      {
+        archive[num_archived++] = cands[c];
+      }
+    }
+
+    qsort(cands, n, sizeof(dse_candidate), dse_compare);
+    printf("Generation %2d:   %d candidates, %d simulated, best %7.3f in %lld bits\n", gen, n, simulated, cands[0].rate,
+           (long long)cands[0].bits);
+    printf("  --custom:%s\n", cands[0].key);
+    fflush(stdout);
+
+    // Keep the better half and breed the rest from it, each child
+    // from the better of two random survivors on either side.
+    // Survivors are scored again from the database
+    int survivors = (n + 1) / 2;
+    int next = survivors;
+    for (int tries = 0; next < pop && tries < pop * DSE_TRIES; tries++)
+    {
+      int a = dse_uniform(&rng, 0, survivors - 1);
+      int b = dse_uniform(&rng, 0, survivors - 1);
+      int c = dse_uniform(&rng, 0, survivors - 1);
+      int d = dse_uniform(&rng, 0, survivors - 1);
+      dse_genome gn;
+      dse_crossover(&rng, &cands[a < b ? a : b].genome, &cands[c < d ? c : d].genome, &gn);
+      dse_mutate(&rng, &gn);
+      dse_build(&cands[next], &gn);
+      if (cands[next].bits <= opt->budget && !dse_seen(archive, num_archived, cands[next].key) &&
+          !dse_seen(cands, next, cands[next].key))
+      {
+        next++;
+      }
+    }
+    n = next;
+  }
+
+  qsort(archive, num_archived, sizeof(dse_candidate), dse_compare);
+  printf("\nBest of %d candidates within %lld bits:\n", num_archived, (long long)opt->budget);
+  for (int i = 0; i < num_archived && i < DSE_LEADERS; i++)
+  {
+    printf("%2d. %7.3f %6lld bits  --custom:%s\n", i + 1, archive[i].rate, (long long)archive[i].bits,
+           archive[i].key);
+  }
+
+  free(cands);
+  free(archive);
+  dse_db_close(&db);
+}
@@ -0,0 +1,32 @@
+//========================================================//
+//  dse.h                                                 //
+//  Header file for the TAGE design-space exploration     //
+//                                                        //
+//  Searches TAGE geometries within a storage budget by   //
+//  evolving a population of candidates, each scored by   //
+//  its mean misprediction rate over a set of traces      //
+//========================================================//
+
+#ifndef DSE_H
+#define DSE_H
+
+#include "predictor.h"
+#include "sweep.h"
+
+struct dse_options {
+  const char *db_path;  // results database, read and appended to
+  int64_t budget;       // storage budget in bits
+  int population;       // candidates per generation
+  int generations;
+  uint64_t seed;
+  int threads;          // as for sweep_run
+};
+
+// Search for the TAGE geometry with the lowest mean misprediction
+// rate over 'traces', printing each generation's best and the
+// overall leaders. Every (candidate, trace) result is appended to
+// the database, and results already there are not simulated again
+//
+void dse_run(const dse_options *opt, const sweep_trace *traces, int num_traces);
+
+#endif
@@ -0,0 +1,118 @@
+//========================================================//
+//  history.h                                             //
+//  Global branch history of arbitrary length             //
+//                                                        //
+//  The history is a circular buffer of N bits packed     //
+//  into 64-bit words, so pushing an outcome costs the    //
+//  same whatever N is. Predictors hash long histories    //
+//  through folded_history registers that follow it in    //
+//  O(1) per branch                                       //
+//========================================================//
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+template <int N>
+class global_history
+{
+  static_assert(N >= 64 && (N & (N - 1)) == 0, "global_history size must be a power of two of at least 64");
+
+public:
+  static const int capacity = N;
+
+  void clear()
+  {
+    memset(words, 0, sizeof(words));
+    head = 0;
+  }
+
+  // Outcome 'i' branches ago, 0 being the most recent
+  uint32_t bit(int i) const
+  {
+    uint32_t p = (head + i) & (N - 1);
+    return (words[p >> 6] >> (p & 63)) & 1;
+  }
+
+  // The most recent 'n' (at most 64) outcomes, newest in bit 0
+  uint64_t recent(int n) const
+  {
+    uint64_t v = 0;
+    for (int i = n - 1; i >= 0; i--)
+    {
+      v = (v << 1) | bit(i);
+    }
+    return v;
+  }
+
+  void push(uint32_t b)
+  {
+    head = (head - 1) & (N - 1);
+    uint64_t m = 1ULL << (head & 63);
+    words[head >> 6] = (words[head >> 6] & ~m) | ((uint64_t)(b & 1) << (head & 63));
+  }
+
+private:
+  uint64_t words[N / 64];
+  uint32_t head; // position of the most recent outcome
+};
+
+// Circular folded history: the XOR of the 'width'-bit chunks of
+// the most recent 'length' history bits, kept up to date in O(1)
+// as the history shifts instead of refolding it for every lookup
+//
+struct folded_history {
+  uint32_t comp;  // folded value
+  int length;     // history bits folded
+  int width;      // bits of the folded value
+  int outpoint;   // where the bit leaving the history lands
+};
+
+static inline void folded_init(folded_history *f, int length, int width)
+{
+  f->length = length;
+  f->width = width;
+  f->outpoint = length % width;
+  f->comp = 0;
+}
+
+// Shift the folded value 'comp' of a window of 'width'-bit chunks
+// as 'bit' enters the history and 'out' leaves the window, which
+// lands at 'outpoint' (window length modulo width)
+//
+static inline uint32_t folded_shift(uint32_t comp, uint32_t out, uint32_t bit, int outpoint, int width)
+{
+  comp = (comp << 1) | bit;
+  comp ^= out << outpoint;
+  comp ^= comp >> width;
+  return comp & ((1U << width) - 1);
+}
+
+// Fold in a history shift that pushes in 'bit'. 'out' is the bit
+// leaving the folded window, bit(length - 1) before the push
+//
+static inline void folded_update(folded_history *f, uint32_t out, uint32_t bit)
+{
+  f->comp = folded_shift(f->comp, out, bit, f->outpoint, f->width);
+}
+
+// Fill 'lens' with 'n' history lengths growing geometrically from
+// 'min_len' to 'max_len', each at least one longer than the last
+//
+static inline void geometric_history_lengths(int n, int min_len, int max_len, int *lens)
+{
+  for (int i = 0; i < n; i++)
+  {
+    double len = n == 1 ? max_len : min_len * pow((double)max_len / min_len, (double)i / (n - 1));
+    lens[i] = (int)(len + 0.5);
+    if (i > 0 && lens[i] <= lens[i - 1])
+    {
+      lens[i] = lens[i - 1] + 1;
+    }
+  }
+}
+
+#endif
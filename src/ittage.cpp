@@ -0,0 +1,291 @@
+//========================================================//
+//  ittage.cpp                                            //
+//  Source file for the ITTAGE target predictor           //
+//                                                        //
+//  After Seznec's ITTAGE: a target is trusted once its   //
+//  counter says so, and a wrong one is replaced only     //
+//  after its confidence has run out. The history takes   //
+//  in conditional outcomes and indirect targets          //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ittage.h"
+
+int ittage_check_geometry(const ittage_geometry *g)
+{
+  if (g->num_tables < 1 || g->num_tables > ITTAGE_MAX_TABLES)
+  {
+    fprintf(stderr, "ITTAGE needs 1 to %d tagged tables, not %d\n", ITTAGE_MAX_TABLES, g->num_tables);
+    return 0;
+  }
+  if (g->hist_len < g->num_tables || g->hist_len > ITTAGE_MAX_HIST - ITTAGE_MAX_TABLES)
+  {
+    fprintf(stderr, "ITTAGE history of %d bits is outside the %d to %d supported\n", g->hist_len, g->num_tables,
+            ITTAGE_MAX_HIST - ITTAGE_MAX_TABLES);
+    return 0;
+  }
+  if (g->base_bits < 1 || g->base_bits > 24 || g->table_bits < 1 || g->table_bits > 24)
+  {
+    fprintf(stderr, "ITTAGE tables need 1 to 24 index bits\n");
+    return 0;
+  }
+  if (g->tag_bits < 2 || g->tag_bits > 16)
+  {
+    fprintf(stderr, "ITTAGE tags need 2 to 16 bits, not %d\n", g->tag_bits);
+    return 0;
+  }
+  return 1;
+}
+
+//------------------------------------//
+//         Target Predictor           //
+//------------------------------------//
+
+IttagePredictor::IttagePredictor(const ittage_geometry *g)
+{
+  geom = *g;
+  geometric_history_lengths(geom.num_tables, ITTAGE_MIN_HIST < geom.hist_len ? ITTAGE_MIN_HIST : 1, geom.hist_len,
+                            table_hist_len);
+
+  base = (ittage_entry *)calloc((size_t)1 << geom.base_bits, sizeof(ittage_entry));
+  memset(tables, 0, sizeof(tables));
+  memset(fold_index, 0, sizeof(fold_index));
+  memset(fold_tag, 0, sizeof(fold_tag));
+  for (int i = 0; i < geom.num_tables; i++)
+  {
+    tables[i] = (ittage_entry *)calloc((size_t)1 << geom.table_bits, sizeof(ittage_entry));
+    folded_init(&fold_index[i], table_hist_len[i], geom.table_bits);
+    folded_init(&fold_tag[i][0], table_hist_len[i], geom.tag_bits);
+    folded_init(&fold_tag[i][1], table_hist_len[i], geom.tag_bits - 1);
+  }
+  ghistory.clear();
+  lfsr = 0xACE1;
+}
+
+IttagePredictor::~IttagePredictor()
+{
+  free(base);
+  for (int i = 0; i < geom.num_tables; i++)
+  {
+    free(tables[i]);
+  }
+}
+
+uint32_t IttagePredictor::lookup(uint32_t pc, ittage_context *ctx)
+{
+  uint32_t p = pc >> 2;
+  uint32_t index_mask = (1 << geom.table_bits) - 1;
+  uint32_t tag_mask = (1 << geom.tag_bits) - 1;
+
+  ctx->base = p & ((1 << geom.base_bits) - 1);
+  ctx->provider = -1;
+  ctx->alt = -1;
+  for (int i = 0; i < geom.num_tables; i++)
+  {
+    ctx->index[i] = (p ^ (p >> (geom.table_bits - i % geom.table_bits)) ^ fold_index[i].comp) & index_mask;
+    ctx->tag[i] = ((p >> geom.table_bits) ^ i ^ fold_tag[i][0].comp ^ (fold_tag[i][1].comp << 1)) & tag_mask;
+  }
+  for (int i = geom.num_tables - 1; i >= 0; i--)
+  {
+    if (tables[i][ctx->index[i]].tag == ctx->tag[i])
+    {
+      if (ctx->provider < 0)
+      {
+        ctx->provider = i;
+      }
+      else
+      {
+        ctx->alt = i;
+        break;
+      }
+    }
+  }
+
+  ctx->alt_pred = ctx->alt >= 0 ? tables[ctx->alt][ctx->index[ctx->alt]].target : base[ctx->base].target;
+  ctx->pred = ctx->alt_pred;
+  if (ctx->provider >= 0)
+  {
+    // a newly allocated target with no confidence yet defers to
+    // the shorter history
+    const ittage_entry *e = &tables[ctx->provider][ctx->index[ctx->provider]];
+    if (e->ctr > 0 || ctx->alt_pred == 0)
+    {
+      ctx->pred = e->target;
+    }
+  }
+  return ctx->pred;
+}
+
+// Step the confidence of 'e' towards 'target', replacing the target
+// once the confidence has run out
+//
+static void ittage_train_entry(ittage_entry *e, uint32_t target)
+{
+  if (e->target == target)
+  {
+    e->ctr += e->ctr < ITTAGE_CTR_MAX;
+  }
+  else if (e->ctr > 0)
+  {
+    e->ctr--;
+  }
+  else
+  {
+    e->target = target;
+  }
+}
+
+void IttagePredictor::update(const ittage_context *ctx, uint32_t target)
+{
+  if (ctx->provider >= 0)
+  {
+    ittage_entry *e = &tables[ctx->provider][ctx->index[ctx->provider]];
+    if (e->target != ctx->alt_pred)
+    {
+      e->u = e->target == target;
+    }
+    ittage_train_entry(e, target);
+    if (ctx->pred == ctx->alt_pred && e->ctr == 0)
+    {
+      ittage_train_entry(ctx->alt >= 0 ? &tables[ctx->alt][ctx->index[ctx->alt]] : &base[ctx->base], target);
+    }
+  }
+  else
+  {
+    ittage_train_entry(&base[ctx->base], target);
+  }
+
+  // On a miss, allocate in one of the longer tables, from a random
+  // one of the first two free; age them all if none is
+  if (ctx->pred != target && ctx->provider < geom.num_tables - 1)
+  {
+    lfsr = (lfsr >> 1) ^ (-(lfsr & 1) & 0xB400);
+    int start = ctx->provider + 1;
+    if ((lfsr & 1) && start < geom.num_tables - 1 && tables[start + 1][ctx->index[start + 1]].u == 0)
+    {
+      start++;
+    }
+    int allocated = 0;
+    for (int i = start; i < geom.num_tables && !allocated; i++)
+    {
+      ittage_entry *e = &tables[i][ctx->index[i]];
+      if (e->u == 0)
+      {
+        e->tag = ctx->tag[i];
+        e->target = target;
+        e->ctr = 0;
+        allocated = 1;
+      }
+    }
+    for (int i = start; i < geom.num_tables && !allocated; i++)
+    {
+      tables[i][ctx->index[i]].u = 0;
+    }
+  }
+}
+
+void IttagePredictor::push_history(uint32_t bits, int n)
+{
+  for (int b = 0; b < n; b++)
+  {
+    uint32_t bit = (bits >> b) & 1;
+    for (int i = 0; i < geom.num_tables; i++)
+    {
+      uint32_t out = ghistory.bit(table_hist_len[i] - 1);
+      folded_update(&fold_index[i], out, bit);
+      folded_update(&fold_tag[i][0], out, bit);
+      folded_update(&fold_tag[i][1], out, bit);
+    }
+    ghistory.push(bit);
+  }
+}
+
+void IttagePredictor::storage(const ittage_geometry *g, storage_report *r)
+{
+  int ctr_bits = storage_count_bits(ITTAGE_CTR_MAX + 1);
+  storage_add(r, (int64_t)(ITTAGE_TARGET_BITS + ctr_bits) << g->base_bits, "ITTAGE base targets");
+  storage_add(r, ((int64_t)g->num_tables * (ITTAGE_TARGET_BITS + g->tag_bits + ctr_bits + 1)) << g->table_bits,
+              "ITTAGE tagged targets");
+  storage_add(r, g->hist_len + (int64_t)g->num_tables * (g->table_bits + 2 * g->tag_bits - 1) + 16,
+              "ITTAGE history, folds, LFSR");
+}
+
+//------------------------------------//
+//          ITTAGE Attached           //
+//------------------------------------//
+
+IttageAttachedPredictor::IttageAttachedPredictor(Predictor *inner, const ittage_geometry *g)
+  : ittage(g)
+{
+  this->inner = inner;
+  geom = *g;
+  branches = 0;
+  indirect = 0;
+  target_misses = 0;
+  returns = 0;
+  return_misses = 0;
+}
+
+IttageAttachedPredictor::~IttageAttachedPredictor()
+{
+  delete inner;
+}
+
+uint8_t IttageAttachedPredictor::predict(uint32_t pc, uint32_t target, uint32_t direct)
+{
+  return inner->predict(pc, target, direct);
+}
+
+void IttageAttachedPredictor::train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct)
+{
+  inner->train(pc, target, outcome, condition, call, ret, direct);
+  branches++;
+  if (!direct)
+  {
+    predict_target(pc, target, ret);
+  }
+  ittage.push_history(outcome, 1);
+}
+
+void IttageAttachedPredictor::track(uint32_t pc, uint32_t target, uint32_t call, uint32_t ret, uint32_t direct)
+{
+  inner->track(pc, target, call, ret, direct);
+  if (!direct)
+  {
+    predict_target(pc, target, ret);
+  }
+}
+
+void IttageAttachedPredictor::predict_target(uint32_t pc, uint32_t target, uint32_t ret)
+{
+  ittage_context ctx;
+  uint32_t pred = ittage.lookup(pc, &ctx);
+  indirect++;
+  returns += ret != 0;
+  if (pred != target)
+  {
+    target_misses++;
+    return_misses += ret != 0;
+  }
+  ittage.update(&ctx, target);
+  ittage.push_history((target >> 2) ^ (target >> 5), 2);
+}
+
+void IttageAttachedPredictor::storage(storage_report *r)
+{
+  // the ITTAGE is outside the direction budget, see spec_storage()
+  inner->storage(r);
+}
+
+void IttageAttachedPredictor::format_stats(char *buf, size_t size)
+{
+  inner->format_stats(buf, size);
+  size_t len = strlen(buf);
+  snprintf(buf + len, size - len,
+           "Indirect:        %10llu (%llu returns)\n"
+           "Target Incorrect:%10llu (%llu returns)\n"
+           "Target Rate:        %7.3f\n",
+           (unsigned long long)indirect, (unsigned long long)returns, (unsigned long long)target_misses,
+           (unsigned long long)return_misses, branches ? 1000.0 * target_misses / branches : 0.0);
+}
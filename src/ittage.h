@@ -0,0 +1,107 @@
+//========================================================//
+//  ittage.h                                              //
+//  Header file for the ITTAGE target predictor           //
+//                                                        //
+//  Predicts the target of indirect branches: a base      //
+//  table of targets by pc, and tagged tables of targets  //
+//  indexed with global histories of geometric lengths,   //
+//  the longest matching one providing the target         //
+//========================================================//
+
+#ifndef ITTAGE_H
+#define ITTAGE_H
+
+#include "predictor.h"
+
+#define ITTAGE_MAX_HIST 1024   // longest global history
+#define ITTAGE_MIN_HIST 4      // history of the shortest tagged table
+#define ITTAGE_CTR_MAX 3       // 2-bit target confidence
+#define ITTAGE_TARGET_BITS 32
+
+// An entry of the base table or of a tagged one, where 'u' marks
+// targets that beat the shorter history
+struct ittage_entry {
+  uint32_t target;
+  uint16_t tag;
+  uint8_t ctr;
+  uint8_t u;
+};
+
+// What the lookup of one branch found, for its update
+struct ittage_context {
+  uint32_t base;                     // base table index
+  uint32_t index[ITTAGE_MAX_TABLES];
+  uint16_t tag[ITTAGE_MAX_TABLES];
+  int provider;                      // longest hitting table, -1 for the base
+  int alt;                           // next longest, -1 for the base
+  uint32_t pred;
+  uint32_t alt_pred;
+};
+
+// Returns True if 'g' can be simulated, printing why not otherwise
+//
+int ittage_check_geometry(const ittage_geometry *g);
+
+class IttagePredictor
+{
+public:
+  IttagePredictor(const ittage_geometry *g);
+  ~IttagePredictor();
+
+  // Returns the predicted target of the indirect branch at 'pc',
+  // filling 'ctx'
+  //
+  uint32_t lookup(uint32_t pc, ittage_context *ctx);
+
+  // Train on the branch going to 'target' after a lookup
+  //
+  void update(const ittage_context *ctx, uint32_t target);
+
+  // Push 'n' bits of 'bits' into the global history
+  //
+  void push_history(uint32_t bits, int n);
+
+  static void storage(const ittage_geometry *g, storage_report *r);
+
+private:
+  ittage_geometry geom;
+  int table_hist_len[ITTAGE_MAX_TABLES];
+  ittage_entry *base;
+  ittage_entry *tables[ITTAGE_MAX_TABLES];
+
+  global_history<ITTAGE_MAX_HIST> ghistory;
+  folded_history fold_index[ITTAGE_MAX_TABLES];
+  folded_history fold_tag[ITTAGE_MAX_TABLES][2];
+  uint32_t lfsr;  // picks among the tables free to allocate
+};
+
+// Any predictor with an ITTAGE predicting the targets of its
+// indirect branches, whose misses are reported as stats
+class IttageAttachedPredictor : public Predictor
+{
+public:
+  // Takes ownership of 'inner'
+  IttageAttachedPredictor(Predictor *inner, const ittage_geometry *g);
+  ~IttageAttachedPredictor();
+  uint8_t predict(uint32_t pc, uint32_t target, uint32_t direct);
+  void train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct);
+  void track(uint32_t pc, uint32_t target, uint32_t call, uint32_t ret, uint32_t direct);
+  void storage(storage_report *r);
+  void format_stats(char *buf, size_t size);
+
+private:
+  // Predict and train the target of the indirect branch at 'pc'
+  void predict_target(uint32_t pc, uint32_t target, uint32_t ret);
+
+  Predictor *inner;
+  IttagePredictor ittage;
+  ittage_geometry geom;
+
+  uint64_t branches;        // conditional, as for the misprediction rate
+  uint64_t indirect;
+  uint64_t target_misses;
+  uint64_t returns;
+  uint64_t return_misses;
+};
+
+#endif
@@ -0,0 +1,198 @@
+//========================================================//
+//  loop.cpp                                              //
+//  Source file for the loop predictor                    //
+//                                                        //
+//  Follows the loop predictor of L-TAGE: an entry gains  //
+//  confidence each time a loop exits after the same      //
+//  number of iterations, and is freed on its first       //
+//  misprediction once confident                          //
+//========================================================//
+#include <stdio.h>
+#include <string.h>
+#include "loop.h"
+
+#define LOOP_ITER_MASK ((1 << LOOP_ITER_BITS) - 1)
+
+LoopPredictor::LoopPredictor()
+{
+  memset(table, 0, sizeof(table));
+  use.value = SatCounter<7>::max / 2 + 1;
+  lfsr = 0xACE1;
+  overrides = 0;
+  fixed = 0;
+}
+
+void LoopPredictor::lookup(uint32_t pc, loop_context *ctx)
+{
+  ctx->set = ((pc >> 2) & ((1 << LOOP_SET_BITS) - 1)) * LOOP_WAYS;
+  ctx->tag = (pc >> (2 + LOOP_SET_BITS)) & ((1 << LOOP_TAG_BITS) - 1);
+  ctx->way = -1;
+  ctx->valid = 0;
+  ctx->pred = NOTTAKEN;
+  for (int w = 0; w < LOOP_WAYS; w++)
+  {
+    const loop_entry *e = &table[ctx->set + w];
+    if (e->tag == ctx->tag)
+    {
+      ctx->way = w;
+      ctx->valid = e->conf == LOOP_CONF_MAX;
+      ctx->pred = (e->current_iter + 1 == e->past_iter) ? !e->dir : e->dir;
+      return;
+    }
+  }
+}
+
+uint8_t LoopPredictor::predict(const loop_context *ctx, uint8_t other_pred) const
+{
+  return (ctx->valid && use.predict()) ? ctx->pred : other_pred;
+}
+
+void LoopPredictor::update(const loop_context *ctx, uint32_t outcome, uint8_t other_pred)
+{
+  // a Galois LFSR picks the ways tried for allocation
+  lfsr = (lfsr >> 1) ^ (-(lfsr & 1) & 0xB400);
+
+  if (predict(ctx, other_pred) != other_pred)
+  {
+    overrides++;
+    fixed += ctx->pred == outcome;
+  }
+  if (ctx->valid && ctx->pred != other_pred)
+  {
+    use.update(ctx->pred == outcome);
+  }
+
+  if (ctx->way >= 0)
+  {
+    loop_entry *e = &table[ctx->set + ctx->way];
+    if (ctx->valid)
+    {
+      if (ctx->pred != outcome)
+      {
+        memset(e, 0, sizeof(*e));
+        return;
+      }
+      if (ctx->pred != other_pred && e->age < LOOP_AGE_MAX)
+      {
+        e->age++;
+      }
+    }
+
+    e->current_iter = (e->current_iter + 1) & LOOP_ITER_MASK;
+    if (e->current_iter > e->past_iter)
+    {
+      // longer than the trip count learned, start over
+      e->conf = 0;
+      e->past_iter = 0;
+    }
+    if (outcome != e->dir)
+    {
+      if (e->current_iter == e->past_iter)
+      {
+        if (e->conf < LOOP_CONF_MAX)
+        {
+          e->conf++;
+        }
+        if (e->past_iter < 3)
+        {
+          // too short to be worth an entry, or the loop runs the
+          // other way
+          e->dir = outcome;
+          e->past_iter = 0;
+          e->age = 0;
+          e->conf = 0;
+        }
+      }
+      else
+      {
+        e->past_iter = e->past_iter == 0 ? e->current_iter : 0;
+        e->conf = 0;
+      }
+      e->current_iter = 0;
+    }
+  }
+  else if (outcome != other_pred && (lfsr & 3) == 0)
+  {
+    // Allocate in the first way, from a random one, whose age has
+    // run out, aging the others
+    int start = (lfsr >> 2) & (LOOP_WAYS - 1);
+    for (int i = 0; i < LOOP_WAYS; i++)
+    {
+      loop_entry *e = &table[ctx->set + ((start + i) & (LOOP_WAYS - 1))];
+      if (e->age == 0)
+      {
+        e->tag = ctx->tag;
+        e->dir = !outcome;
+        e->past_iter = 0;
+        e->current_iter = 0;
+        e->conf = 0;
+        e->age = LOOP_AGE_MAX;
+        break;
+      }
+      e->age--;
+    }
+  }
+}
+
+void LoopPredictor::storage(storage_report *r)
+{
+  storage_add(r, (entry_bits << LOOP_SET_BITS) * LOOP_WAYS, "loop table");
+  storage_add(r, 7, "loop use counter");
+  storage_add(r, LOOP_LFSR_BITS, "loop allocation LFSR");
+}
+
+void LoopPredictor::format_stats(char *buf, size_t size) const
+{
+  snprintf(buf, size,
+           "Loop overrides:  %10llu\n"
+           "Loop removed:    %10lld mispredictions\n",
+           (unsigned long long)overrides, (long long)fixed - (long long)(overrides - fixed));
+}
+
+//------------------------------------//
+//           Loop Override            //
+//------------------------------------//
+
+LoopOverridePredictor::LoopOverridePredictor(Predictor *inner)
+{
+  this->inner = inner;
+  inner_pred = NOTTAKEN;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.way = -1;
+}
+
+LoopOverridePredictor::~LoopOverridePredictor()
+{
+  delete inner;
+}
+
+uint8_t LoopOverridePredictor::predict(uint32_t pc, uint32_t target, uint32_t direct)
+{
+  inner_pred = inner->predict(pc, target, direct);
+  loop.lookup(pc, &ctx);
+  return loop.predict(&ctx, inner_pred);
+}
+
+void LoopOverridePredictor::train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct)
+{
+  loop.update(&ctx, outcome, inner_pred);
+  inner->train(pc, target, outcome, condition, call, ret, direct);
+}
+
+void LoopOverridePredictor::track(uint32_t pc, uint32_t target, uint32_t call, uint32_t ret, uint32_t direct)
+{
+  inner->track(pc, target, call, ret, direct);
+}
+
+void LoopOverridePredictor::storage(storage_report *r)
+{
+  inner->storage(r);
+  LoopPredictor::storage(r);
+}
+
+void LoopOverridePredictor::format_stats(char *buf, size_t size)
+{
+  inner->format_stats(buf, size);
+  size_t len = strlen(buf);
+  loop.format_stats(buf + len, size - len);
+}
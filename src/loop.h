@@ -0,0 +1,105 @@
+//========================================================//
+//  loop.h                                                //
+//  Header file for the loop predictor                    //
+//                                                        //
+//  Learns the trip count of loops whose exit branch      //
+//  runs a constant number of iterations, however long,   //
+//  and overrides another predictor on the branches it    //
+//  is confident about                                    //
+//========================================================//
+
+#ifndef LOOP_H
+#define LOOP_H
+
+#include "predictor.h"
+
+#define LOOP_SET_BITS 4    // 16 sets
+#define LOOP_WAYS 4
+#define LOOP_TAG_BITS 10
+#define LOOP_ITER_BITS 10  // longest trip count learned is 2^10 - 1
+#define LOOP_CONF_MAX 3    // 2-bit confidence, predicting once saturated
+#define LOOP_AGE_MAX 7     // 3-bit age, protecting entries from replacement
+#define LOOP_LFSR_BITS 16
+
+// A loop: the direction of its branch while iterating, the
+// iterations of its last complete run and of the current one
+struct loop_entry {
+  uint16_t tag;
+  uint16_t past_iter;
+  uint16_t current_iter;
+  uint8_t conf;
+  uint8_t age;
+  uint8_t dir;
+};
+
+// What the lookup of one branch found, for its update
+struct loop_context {
+  uint32_t set;
+  uint32_t tag;
+  int way;        // hitting way, -1 on a miss
+  uint8_t valid;  // hit with saturated confidence
+  uint8_t pred;
+};
+
+class LoopPredictor
+{
+public:
+  LoopPredictor();
+
+  // Look up the branch at 'pc', filling 'ctx'
+  //
+  void lookup(uint32_t pc, loop_context *ctx);
+
+  // Returns the loop prediction if it is confident and has been
+  // beating 'other_pred', the prediction it overrides, 'other_pred'
+  // otherwise
+  //
+  uint8_t predict(const loop_context *ctx, uint8_t other_pred) const;
+
+  // Train on 'outcome' after a lookup. Entries are allocated when
+  // 'other_pred' was wrong
+  //
+  void update(const loop_context *ctx, uint32_t outcome, uint8_t other_pred);
+
+  static void storage(storage_report *r);
+
+  // Write how often the loop predictor overrode and how many
+  // mispredictions that removed
+  //
+  void format_stats(char *buf, size_t size) const;
+
+  static constexpr int64_t entry_bits = LOOP_TAG_BITS + 2 * LOOP_ITER_BITS + 2 + 3 + 1;
+  static constexpr int64_t storage_bits = (entry_bits << LOOP_SET_BITS) * LOOP_WAYS + 7 + LOOP_LFSR_BITS;
+
+private:
+  loop_entry table[(1 << LOOP_SET_BITS) * LOOP_WAYS];
+  SatCounter<7> use;  // loop predictions beating the other, taken above the middle
+  uint32_t lfsr;
+
+  uint64_t overrides;  // predictions changed
+  uint64_t fixed;      // of which were right
+};
+
+// Any predictor with a loop predictor in front of it
+class LoopOverridePredictor : public Predictor
+{
+public:
+  // Takes ownership of 'inner'
+  LoopOverridePredictor(Predictor *inner);
+  ~LoopOverridePredictor();
+  uint8_t predict(uint32_t pc, uint32_t target, uint32_t direct);
+  void train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct);
+  void track(uint32_t pc, uint32_t target, uint32_t call, uint32_t ret, uint32_t direct);
+  void storage(storage_report *r);
+  void format_stats(char *buf, size_t size);
+
+private:
+  Predictor *inner;
+  LoopPredictor loop;
+
+  // lookups of the last predict(), used by train()
+  uint8_t inner_pred;
+  loop_context ctx;
+};
+
+#endif
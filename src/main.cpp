@@ -8,25 +8,176 @@
 #include <stdlib.h>
 #include <string.h>
 #include "predictor.h"
+#include "trace.h"
+#include "pipeline.h"
+#include "sweep.h"
+#include "dse.h"
+#include "tage.h"
 
-FILE *stream;
-char *buf = NULL;
-size_t len = 0;
+trace_t trace;
+branch_batch batch;
+const char *trace_path = "-";  // stdin unless a file is given
+const char **trace_paths = NULL;
+int num_traces = 0;
+int sweep_threads = -1;
+const char *convert_path = NULL;
+int pipelined = 0;
+int report_storage = 0;
+int64_t storage_budget = 0; // bits, 0 for no limit
+int halving_eta = 0;        // 0 to run every sweep job to the end
+dse_options dse = {NULL, 0, 16, 8, 1, -1};
+pipeline *trace_pipe = NULL;
+
+// Predictor configurations simulated side by side, each fed every
+// branch of the single pass over the trace
+#define MAX_CONFIGS 32
+
+struct sim_config {
+  predictor_spec spec;
+  Predictor *predictor;
+  sim_result result;
+};
+
+sim_config configs[MAX_CONFIGS];
+int num_configs = 0;
+uint8_t predictions[MAX_CONFIGS][TRACE_BATCH];
 
 // Print out the Usage information to stderr
 //
 void usage()
 {
-  fprintf(stderr, "Usage: predictor <options> [<trace>]\n");
+  fprintf(stderr, "Usage: predictor <options> [<trace>...]\n");
   fprintf(stderr, "       bunzip2 -kc trace.bz2 | predictor <options>\n");
+  fprintf(stderr, " <trace> may be text, bzip2 compressed text or a binary trace\n");
   fprintf(stderr, " Options:\n");
   fprintf(stderr, " --help       Print this message\n");
   fprintf(stderr, " --verbose    Print predictions on stdout\n");
-  fprintf(stderr, " --<type>     Branch prediction scheme:\n");
+  fprintf(stderr, " --convert=<file>  Write the trace as a binary trace to <file>\n");
+  fprintf(stderr, " --pipeline   Read, parse and predict on separate threads\n");
+  fprintf(stderr, " --no-simd    Match TAGE tags with scalar code only\n");
+  fprintf(stderr, " --verify-simd  Check every SIMD TAGE tag match against scalar\n");
+  fprintf(stderr, " --threads=<n>  Run every trace and scheme pair as a job on n\n"
+                  "              threads (0 for one per CPU), the default with\n"
+                  "              several traces\n");
+  fprintf(stderr, " --halving[=<eta>]  Run the sweep by successive halving: every\n"
+                  "              scheme on 1/eta^2 of each trace, the best 1/eta\n"
+                  "              of them on 1/eta, and the best 1/eta of those\n"
+                  "              to the end, eta 4 by default\n");
+  fprintf(stderr, " --storage    Print the modeled storage of each scheme and exit\n");
+  fprintf(stderr, " --budget[=<bits>]  Reject schemes over <bits> of storage, by\n"
+                  "              default %d. It holds direction prediction;\n"
+                  "              an ITTAGE is reported apart and not held to it\n", STORAGE_BUDGET_BITS);
+  fprintf(stderr, " --dse=<file>  Search for the TAGE geometry with the best mean\n"
+                  "              misprediction rate over the traces within the\n"
+                  "              budget, keeping every result in <file>\n");
+  fprintf(stderr, " --dse-population=<n>  Candidates per generation, default %d\n", dse.population);
+  fprintf(stderr, " --dse-generations=<n>  Generations to search, default %d\n", dse.generations);
+  fprintf(stderr, " --dse-seed=<n>  Seed of the search, default %llu\n", (unsigned long long)dse.seed);
+  fprintf(stderr, " --config=<file>  Read options from <file>, whitespace separated\n"
+                  "              with the leading -- optional and # comments\n");
+  fprintf(stderr, " --<type>[:<key>=<value>,...]  Branch prediction scheme, repeat\n"
+                  "              to simulate several in one pass over the trace,\n"
+                  "              with the sizes of its tables in bits, and\n"
+                  "              loop=1 to put a loop predictor in front, and\n"
+                  "              ittage=1 to predict indirect targets with an\n"
+                  "              ITTAGE of itables, ihist, ibase, iindex, itag:\n");
   fprintf(stderr, "    static\n"
-                  "    gshare\n"
-                  "    tournament\n"
-                  "    custom\n");
+                  "    gshare       ghist\n"
+                  "    tournament   ghist, lhist, lpt, choice\n"
+                  "    custom[=<name>]  TAGE, by default or starting from a\n"
+                  "                 configuration:");
+  for (int i = 0; i < num_tage_variants; i++)
+  {
+    fprintf(stderr, " %s", tage_variants[i].name);
+  }
+  fprintf(stderr, "\n"
+                  "                 tables, hist, base, index, tag, udecay and\n"
+                  "                 lens=<l0>/<l1>/... one per table\n"
+                  "    tage-scl[=<name>]  TAGE-SC-L, TAGE with a statistical\n"
+                  "                 corrector and a loop predictor, with the\n"
+                  "                 keys of custom for its TAGE\n"
+                  "    perceptron   Hashed perceptron: tables, index, hist and\n"
+                  "                 weight\n"
+                  "    mpp          Multiperspective perceptron: index, weight and\n"
+                  "                 features=<f0>/<f1>/... each one of pc,\n"
+                  "                 g<start>-<end>, path<n>, local<n> or\n"
+                  "                 call<n>, with @<index> to size its table\n");
+}
+
+// Add the predictor configuration a scheme option names, without
+// its leading "--"
+//
+// Returns True if Successful
+//
+int add_config(const char *option)
+{
+  if (num_configs == MAX_CONFIGS)
+  {
+    fprintf(stderr, "Too many predictor configurations, at most %d\n", MAX_CONFIGS);
+    return 0;
+  }
+  if (!parse_spec(&configs[num_configs].spec, option))
+  {
+    return 0;
+  }
+  configs[num_configs].predictor = NULL;
+  configs[num_configs].result.num_branches = 0;
+  configs[num_configs].result.mispredictions = 0;
+  bpType = configs[num_configs].spec.type;
+  num_configs++;
+  return 1;
+}
+
+int handle_option(char *arg);
+
+#define MAX_CONFIG_DEPTH 8 // config files including config files
+
+// Process the options in a config file, one or more to a line
+//
+// Returns True if Successful
+//
+int read_config(const char *path)
+{
+  static int depth = 0;
+  if (depth == MAX_CONFIG_DEPTH)
+  {
+    fprintf(stderr, "Config file %s is nested more than %d deep, does it include itself?\n", path,
+            MAX_CONFIG_DEPTH);
+    return 0;
+  }
+
+  FILE *f = fopen(path, "r");
+  if (f == NULL)
+  {
+    fprintf(stderr, "Unable to open config file %s\n", path);
+    return 0;
+  }
+
+  char line[1024];
+  char *save;
+  int line_num = 0;
+  int ok = 1;
+  depth++;
+  while (ok && fgets(line, sizeof(line), f) != NULL)
+  {
+    line_num++;
+    line[strcspn(line, "#")] = '\0';
+    for (char *tok = strtok_r(line, " \t\r\n", &save); ok && tok != NULL; tok = strtok_r(NULL, " \t\r\n", &save))
+    {
+      // Options are kept for the life of the run, as specs point
+      // into them
+      char *option = (char *)malloc(strlen(tok) + 3);
+      sprintf(option, "%s%s", strncmp(tok, "--", 2) ? "--" : "", tok);
+      if (!handle_option(option))
+      {
+        fprintf(stderr, "%s:%d: Rejected option %s\n", path, line_num, tok);
+        ok = 0;
+      }
+    }
+  }
+  depth--;
+  fclose(f);
+  return ok;
 }
 
 // Process an option and update the predictor
@@ -36,26 +187,86 @@ void usage()
 //
 int handle_option(char *arg)
 {
-  if (!strcmp(arg, "--static"))
+  if (spec_type(arg + 2) >= 0)
+  {
+    return add_config(arg + 2);
+  }
+  else if (!strncmp(arg, "--config=", 9) && arg[9] != '\0')
+  {
+    return read_config(arg + 9);
+  }
+  else if (!strcmp(arg, "--halving"))
+  {
+    halving_eta = 4;
+  }
+  else if (!strncmp(arg, "--halving=", 10) && arg[10] != '\0')
   {
-    bpType = STATIC;
+    char *end;
+    halving_eta = strtol(arg + 10, &end, 10);
+    return *end == '\0' && halving_eta >= 2;
   }
-  else if (!strncmp(arg, "--gshare", 8))
+  else if (!strcmp(arg, "--storage"))
   {
-    bpType = GSHARE;
+    report_storage = 1;
   }
-  else if (!strncmp(arg, "--tournament", 12))
+  else if (!strcmp(arg, "--budget"))
   {
-    bpType = TOURNAMENT;
+    storage_budget = STORAGE_BUDGET_BITS;
   }
-  else if (!strncmp(arg, "--custom", 8))
+  else if (!strncmp(arg, "--budget=", 9) && arg[9] != '\0')
   {
-    bpType = CUSTOM;
+    char *end;
+    storage_budget = strtoll(arg + 9, &end, 10);
+    return *end == '\0' && storage_budget > 0;
+  }
+  else if (!strncmp(arg, "--dse=", 6) && arg[6] != '\0')
+  {
+    dse.db_path = arg + 6;
+  }
+  else if (!strncmp(arg, "--dse-population=", 17))
+  {
+    char *end;
+    dse.population = strtol(arg + 17, &end, 10);
+    return arg[17] != '\0' && *end == '\0' && dse.population >= 2;
+  }
+  else if (!strncmp(arg, "--dse-generations=", 18))
+  {
+    char *end;
+    dse.generations = strtol(arg + 18, &end, 10);
+    return arg[18] != '\0' && *end == '\0' && dse.generations >= 1;
+  }
+  else if (!strncmp(arg, "--dse-seed=", 11))
+  {
+    char *end;
+    dse.seed = strtoull(arg + 11, &end, 10);
+    return arg[11] != '\0' && *end == '\0';
   }
   else if (!strcmp(arg, "--verbose"))
   {
     verbose = 1;
   }
+  else if (!strcmp(arg, "--no-simd"))
+  {
+    tage_match_kernel = TAGE_MATCH_SCALAR;
+  }
+  else if (!strcmp(arg, "--verify-simd"))
+  {
+    tage_verify_simd = 1;
+  }
+  else if (!strcmp(arg, "--pipeline"))
+  {
+    pipelined = 1;
+  }
+  else if (!strncmp(arg, "--threads=", 10) && arg[10] != '\0')
+  {
+    char *end;
+    sweep_threads = strtol(arg + 10, &end, 10);
+    return *end == '\0' && sweep_threads >= 0;
+  }
+  else if (!strncmp(arg, "--convert=", 10) && arg[10] != '\0')
+  {
+    convert_path = arg + 10;
+  }
   else
   {
     return 0;
@@ -64,31 +275,163 @@ int handle_option(char *arg)
   return 1;
 }
 
-// Reads a line from the input stream and extracts the
-// PC and Outcome of a branch
+// Reads the next batch of branches from the trace into
+// structure-of-arrays buffers
 //
-// Returns True if Successful
+// Returns the number of branches read, 0 at the end of the trace
+//
+size_t read_branch_batch(branch_batch *b)
+{
+  return trace_read_batch(&trace, b);
+}
+
+// Returns the next batch of branches, from the pipeline if one
+// is running, or NULL at the end of the trace
 //
-int read_branch(uint32_t *pc, uint32_t *target, uint32_t *outcome, uint32_t *condition, uint32_t *call, uint32_t *ret, uint32_t *direct)
+branch_batch *next_batch()
 {
-  if (getline(&buf, &len, stream) == -1)
+  if (trace_pipe != NULL)
   {
-    return 0;
+    return pipeline_next(trace_pipe);
+  }
+  return read_branch_batch(&batch) ? &batch : NULL;
+}
+
+// Warn about trace lines the parser had to skip
+//
+void report_malformed(const parse_stats *stats)
+{
+  if (stats->malformed > 0)
+  {
+    fprintf(stderr, "Warning: skipped %llu malformed trace lines, first at line %llu\n",
+            (unsigned long long)stats->malformed, (unsigned long long)stats->first_malformed);
   }
+}
 
-  sscanf(buf, "0x%x\t0x%x\t%d\t%d\t%d\t%d\t%d\n", pc, target, outcome, condition, call, ret, direct);
+// Print the name of a predictor configuration
+//
+void print_spec(const predictor_spec *spec)
+{
+  printf("Predictor:       %s%s\n", bpName[spec->type], spec->params != NULL ? spec->params : "");
+}
 
-  return 1;
+// Print the modeled storage of a predictor configuration,
+// structure by structure
+//
+void print_storage(const predictor_spec *spec)
+{
+  storage_report r;
+  storage_report target;
+  spec_storage(spec, &r, &target);
+  print_spec(spec);
+  printf("Storage:         %10lld bits\n", (long long)r.total);
+  for (int i = 0; i < r.count; i++)
+  {
+    printf("  %-26s %10lld\n", r.items[i].name, (long long)r.items[i].bits);
+  }
+  if (storage_budget > 0)
+  {
+    printf("Budget:          %10lld bits, %s\n", (long long)storage_budget,
+           r.total <= storage_budget ? "within" : "OVER");
+  }
+  if (target.count > 0)
+  {
+    printf("Target storage:  %10lld bits, outside the budget\n", (long long)target.total);
+    for (int i = 0; i < target.count; i++)
+    {
+      printf("  %-26s %10lld\n", target.items[i].name, (long long)target.items[i].bits);
+    }
+  }
+}
+
+// Print the mispredict statistics of one simulation
+//
+void print_result(const sim_result *r)
+{
+  printf("Branches:        %10d\n", r->num_branches);
+  printf("Incorrect:       %10d\n", r->mispredictions);
+  float mispredict_rate = 1000 * ((float)r->mispredictions / (float)r->num_branches);
+  printf("Misprediction Rate: %7.3f\n", mispredict_rate);
+}
+
+// Decode every trace into memory
+//
+sweep_trace *load_traces()
+{
+  sweep_trace *traces = (sweep_trace *)calloc(num_traces, sizeof(sweep_trace));
+  for (int t = 0; t < num_traces; t++)
+  {
+    if (!sweep_load(&traces[t], trace_paths[t]))
+    {
+      fprintf(stderr, "Unable to read trace %s\n", trace_paths[t]);
+      exit(1);
+    }
+    report_malformed(&traces[t].stats);
+    if (traces[t].num_batches == 0)
+    {
+      fprintf(stderr, "Trace %s has no branches\n", trace_paths[t]);
+      exit(1);
+    }
+  }
+  return traces;
+}
+
+void free_traces(sweep_trace *traces)
+{
+  for (int t = 0; t < num_traces; t++)
+  {
+    sweep_free(&traces[t]);
+  }
+  free(traces);
+}
+
+// Decode every trace once and simulate each (trace, scheme) pair
+// as a job on the sweep thread pool
+//
+void run_sweep()
+{
+  sweep_trace *traces = load_traces();
+
+  int num_jobs = num_traces * num_configs;
+  sweep_job *jobs = (sweep_job *)calloc(num_jobs, sizeof(sweep_job));
+  for (int j = 0; j < num_jobs; j++)
+  {
+    jobs[j].trace = &traces[j / num_configs];
+    jobs[j].spec = configs[j % num_configs].spec;
+  }
+  if (halving_eta > 0)
+  {
+    sweep_halving(jobs, num_jobs, sweep_threads, halving_eta);
+  }
+  else
+  {
+    sweep_run(jobs, num_jobs, sweep_threads);
+  }
+
+  for (int j = 0; j < num_jobs; j++)
+  {
+    printf("%sTrace:           %s\n", j == 0 ? "" : "\n", jobs[j].trace->path);
+    print_spec(&jobs[j].spec);
+    if (jobs[j].stopped)
+    {
+      printf("Stopped after:   %9.1f%% of the trace\n", 100.0 * jobs[j].batches_done / jobs[j].trace->num_batches);
+    }
+    print_result(&jobs[j].result);
+    printf("%s", jobs[j].stats);
+  }
+
+  free_traces(traces);
+  free(jobs);
 }
 
 int main(int argc, char *argv[])
 {
   // Set defaults
-  stream = stdin;
   bpType = STATIC;
   verbose = 0;
 
   // Process cmdline Arguments
+  trace_paths = (const char **)calloc(argc, sizeof(const char *));
   for (int i = 1; i < argc; ++i)
   {
     if (!strcmp(argv[i], "--help"))
@@ -108,53 +451,181 @@ int main(int argc, char *argv[])
     else
     {
       // Use as input file
-      stream = fopen(argv[i], "r");
+      trace_paths[num_traces++] = argv[i];
     }
   }
 
-  // Initialize the predictor
-  init_predictor();
+  if (num_traces > 0)
+  {
+    trace_path = trace_paths[0];
+  }
 
-  uint32_t num_branches = 0;
-  uint32_t mispredictions = 0;
-  uint32_t pc = 0;
-  uint32_t target = 0;
-  uint32_t outcome = NOTTAKEN;
-  uint32_t condition = 0;
-  uint32_t call = 0;
-  uint32_t ret = 0;
-  uint32_t direct = 0;
+  // Initialize the predictors, static if none was asked for
+  if (num_configs == 0)
+  {
+    add_config("static");
+  }
 
-  // Reach each branch from the trace
-  while (read_branch(&pc, &target, &outcome, &condition, &call, &ret, &direct))
+  if (report_storage)
   {
-    if (condition == 1)
+    for (int c = 0; c < num_configs; c++)
     {
-      num_branches++;
-      // Make a prediction and compare with actual outcome
-      uint32_t prediction = make_prediction(pc, target, direct);
-      if (prediction != outcome)
-      {
-        mispredictions++;
-      }
-      if (verbose != 0)
+      printf(c == 0 ? "" : "\n");
+      print_storage(&configs[c].spec);
+    }
+    return 0;
+  }
+
+  // Only configurations within the budget are simulated
+  for (int c = 0; c < num_configs; c++)
+  {
+    storage_report r;
+    if (storage_budget > 0 && spec_storage(&configs[c].spec, &r, NULL) > storage_budget)
+    {
+      fprintf(stderr, "%s%s needs %lld bits of storage, over the budget of %lld\n", bpName[configs[c].spec.type],
+              configs[c].spec.params != NULL ? configs[c].spec.params : "", (long long)r.total,
+              (long long)storage_budget);
+      exit(1);
+    }
+  }
+
+  // A design-space exploration searches TAGE geometries in place
+  // of the schemes given
+  if (dse.db_path != NULL)
+  {
+    if (num_traces == 0)
+    {
+      fprintf(stderr, "A design-space exploration needs trace files\n");
+      exit(1);
+    }
+    dse.budget = storage_budget > 0 ? storage_budget : STORAGE_BUDGET_BITS;
+    dse.threads = sweep_threads;
+    sweep_trace *traces = load_traces();
+    dse_run(&dse, traces, num_traces);
+    free_traces(traces);
+    return 0;
+  }
+
+  // Several traces, an explicit thread count or halving run as a
+  // sweep
+  if (num_traces > 1 || sweep_threads >= 0 || halving_eta > 0)
+  {
+    if (convert_path != NULL || verbose != 0 || num_traces == 0)
+    {
+      fprintf(stderr, "A sweep needs trace files and cannot be combined with --convert or --verbose\n");
+      exit(1);
+    }
+    run_sweep();
+    return 0;
+  }
+
+  if (!trace_open(&trace, trace_path))
+  {
+    fprintf(stderr, "Unable to open trace %s\n", trace_path);
+    exit(1);
+  }
+
+  // Conversion only rewrites the trace, no simulation is run
+  if (convert_path != NULL)
+  {
+    int64_t records = trace_convert(&trace, convert_path);
+    if (trace_failed(&trace))
+    {
+      fprintf(stderr, "Unable to read trace %s\n", trace_path);
+      exit(1);
+    }
+    report_malformed(&trace.stats);
+    if (records < 0)
+    {
+      fprintf(stderr, "Unable to write binary trace %s\n", convert_path);
+      exit(1);
+    }
+    if (records == 0)
+    {
+      fprintf(stderr, "Trace %s has no branches\n", trace_path);
+      exit(1);
+    }
+    printf("Converted %lld records to %s\n", (long long)records, convert_path);
+    trace_close(&trace);
+    return 0;
+  }
+
+  for (int c = 0; c < num_configs; c++)
+  {
+    configs[c].predictor = create_predictor(&configs[c].spec);
+  }
+
+  if (pipelined)
+  {
+    trace_pipe = pipeline_start(&trace);
+  }
+
+  // Reach each branch from the trace, a batch at a time. Every
+  // predictor runs over the whole batch before the next one, so
+  // its tables stay in cache while the batch is reused
+  branch_batch *b;
+  while ((b = next_batch()) != NULL)
+  {
+    for (int c = 0; c < num_configs; c++)
+    {
+      simulate_batch(configs[c].predictor, b, &configs[c].result, predictions[c]);
+    }
+
+    if (verbose != 0)
+    {
+      // One line per conditional branch, one column per predictor
+      for (size_t i = 0; i < b->count; i++)
       {
-        printf("%d\n", prediction);
+        if (b->flags[i] & TRACE_CONDITION)
+        {
+          for (int c = 0; c < num_configs; c++)
+          {
+            printf(c == 0 ? "%d" : " %d", predictions[c][i]);
+          }
+          printf("\n");
+        }
       }
     }
-    // Train the predictor
-    train_predictor(pc, target, outcome, condition, call, ret, direct);
   }
 
-  // Print out the mispredict statistics
-  printf("Branches:        %10d\n", num_branches);
-  printf("Incorrect:       %10d\n", mispredictions);
-  float mispredict_rate = 1000 * ((float)mispredictions / (float)num_branches);
-  printf("Misprediction Rate: %7.3f\n", mispredict_rate);
+  if (trace_pipe != NULL)
+  {
+    pipeline_stop(trace_pipe);
+  }
+  if (trace_failed(&trace))
+  {
+    fprintf(stderr, "Unable to read trace %s\n", trace_path);
+    exit(1);
+  }
+  report_malformed(&trace.stats);
+  if (configs[0].result.num_branches == 0)
+  {
+    fprintf(stderr, "Trace %s has no conditional branches\n", trace_path);
+    exit(1);
+  }
+
+  // Print out the mispredict statistics, headed by the scheme
+  // when several were simulated
+  for (int c = 0; c < num_configs; c++)
+  {
+    sim_config *cfg = &configs[c];
+    if (num_configs > 1)
+    {
+      printf(c == 0 ? "" : "\n");
+      print_spec(&cfg->spec);
+    }
+    print_result(&cfg->result);
+    char stats[256];
+    cfg->predictor->format_stats(stats, sizeof(stats));
+    printf("%s", stats);
+  }
 
   // Cleanup
-  fclose(stream);
-  free(buf);
+  for (int c = 0; c < num_configs; c++)
+  {
+    delete configs[c].predictor;
+  }
+  trace_close(&trace);
 
   return 0;
 }
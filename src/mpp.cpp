@@ -0,0 +1,304 @@
+//========================================================//
+//  mpp.cpp                                               //
+//  Source file for the multiperspective perceptron       //
+//                                                        //
+//  Every index is kept up to date as the branch streams  //
+//  by: global segments through folded registers, the     //
+//  path and the call stack through running hashes, so    //
+//  a lookup costs the same whatever the history lengths  //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mpp.h"
+
+static const char *mpp_kind_names[] = {"pc", "g", "path", "local", "call"};
+
+static inline uint32_t rotl(uint32_t v, int n)
+{
+  n &= 31;
+  return n == 0 ? v : (v << n) | (v >> (32 - n));
+}
+
+int mpp_check_features(const mpp_feature *features, int n, int index_bits, int weight_bits)
+{
+  if (n < 1 || n > MPP_MAX_FEATURES)
+  {
+    fprintf(stderr, "Multiperspective perceptron needs 1 to %d features, not %d\n", MPP_MAX_FEATURES, n);
+    return 0;
+  }
+  if (weight_bits < 2 || weight_bits > 8)
+  {
+    fprintf(stderr, "Multiperspective perceptron weights need 2 to 8 bits, not %d\n", weight_bits);
+    return 0;
+  }
+  for (int i = 0; i < n; i++)
+  {
+    const mpp_feature *f = &features[i];
+    char name[32];
+    mpp_format_feature(f, name, sizeof(name));
+    int bits = f->index_bits != 0 ? f->index_bits : index_bits;
+    if (bits < 1 || bits > 24)
+    {
+      fprintf(stderr, "Multiperspective perceptron %s table index of %d bits is outside the 1 to 24 supported\n",
+              name, bits);
+      return 0;
+    }
+    int max = f->kind == MPP_GLOBAL ? MPP_MAX_HIST - f->start
+              : f->kind == MPP_PATH ? MPP_MAX_PATH
+              : f->kind == MPP_LOCAL ? MPP_MAX_LOCAL
+              : f->kind == MPP_CALL ? MPP_MAX_CALL
+              : 0;
+    if (f->kind != MPP_PC && (f->len < 1 || f->len > max))
+    {
+      fprintf(stderr, "Multiperspective perceptron feature %s is outside the lengths supported\n", name);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void mpp_format_feature(const mpp_feature *f, char *buf, size_t size)
+{
+  int len;
+  if (f->kind == MPP_PC)
+  {
+    len = snprintf(buf, size, "pc");
+  }
+  else if (f->kind == MPP_GLOBAL)
+  {
+    len = snprintf(buf, size, "g%d-%d", f->start, f->start + f->len);
+  }
+  else
+  {
+    len = snprintf(buf, size, "%s%d", mpp_kind_names[f->kind], f->len);
+  }
+  if (f->index_bits != 0 && len > 0 && (size_t)len < size)
+  {
+    snprintf(buf + len, size - len, "@%d", f->index_bits);
+  }
+}
+
+//------------------------------------//
+//            Predictor               //
+//------------------------------------//
+
+MppPredictor::MppPredictor(const mpp_feature *features, int n, int index_bits, int weight_bits)
+{
+  num_features = n;
+  this->weight_bits = weight_bits;
+  wmax = (1 << (weight_bits - 1)) - 1;
+  wmin = -wmax - 1;
+
+  size_t size = 0;
+  memset(fold_end, 0, sizeof(fold_end));
+  memset(fold_start, 0, sizeof(fold_start));
+  for (int i = 0; i < n; i++)
+  {
+    this->features[i] = features[i];
+    if (this->features[i].index_bits == 0)
+    {
+      this->features[i].index_bits = index_bits;
+    }
+    int bits = this->features[i].index_bits;
+    offset[i] = size;
+    size += (size_t)1 << bits;
+    if (features[i].kind == MPP_GLOBAL)
+    {
+      folded_init(&fold_end[i], features[i].start + features[i].len, bits);
+      folded_init(&fold_start[i], features[i].start, bits);
+    }
+  }
+  weights = (int8_t *)calloc(size, 1);
+
+  ghistory.clear();
+  memset(path, 0, sizeof(path));
+  path_head = 0;
+  memset(lhist, 0, sizeof(lhist));
+  memset(calls, 0, sizeof(calls));
+  call_top = 0;
+  theta = 2 * n;
+  tc = 0;
+  memset(index, 0, sizeof(index));
+  sum = 0;
+}
+
+MppPredictor::~MppPredictor()
+{
+  free(weights);
+}
+
+uint8_t MppPredictor::predict(uint32_t pc, uint32_t target, uint32_t direct)
+{
+  uint32_t p = pc >> 2;
+  sum = 0;
+  for (int i = 0; i < num_features; i++)
+  {
+    const mpp_feature *f = &features[i];
+    int bits = f->index_bits;
+    uint32_t h = 0;
+    switch (f->kind)
+    {
+    case MPP_GLOBAL:
+      h = fold_end[i].comp ^ fold_start[i].comp;
+      break;
+    case MPP_PATH:
+      h = hash(path[path_head] ^ rotl(path[(path_head - f->len) % (2 * MPP_MAX_PATH)], f->len), 32, bits);
+      break;
+    case MPP_LOCAL:
+      h = hash(lhist[p & ((1 << MPP_LOCAL_BITS) - 1)] & ((1 << f->len) - 1), f->len, bits);
+      break;
+    case MPP_CALL:
+    {
+      uint32_t c = calls[call_top % MPP_CALL_DEPTH];
+      if (call_top >= (uint32_t)f->len)
+      {
+        c ^= rotl(calls[(call_top - f->len) % MPP_CALL_DEPTH], f->len);
+      }
+      h = hash(c, 32, bits);
+      break;
+    }
+    }
+    index[i] = (p ^ (p >> bits) ^ h) & ((1 << bits) - 1);
+    sum += weights[offset[i] + index[i]];
+  }
+  return sum >= 0 ? TAKEN : NOTTAKEN;
+}
+
+void MppPredictor::train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct)
+{
+  uint8_t pred = sum >= 0 ? TAKEN : NOTTAKEN;
+  int abs_sum = sum < 0 ? -sum : sum;
+
+  // Train on mispredictions and sums within theta, and move theta
+  // so both happen about as often
+  if (pred != outcome || abs_sum <= theta)
+  {
+    for (int i = 0; i < num_features; i++)
+    {
+      int8_t *w = &weights[offset[i] + index[i]];
+      if (outcome)
+      {
+        *w += *w < wmax;
+      }
+      else
+      {
+        *w -= *w > wmin;
+      }
+    }
+
+    int tc_max = (1 << (MPP_TC_BITS - 1)) - 1;
+    tc += pred != outcome ? 1 : -1;
+    if (tc > tc_max)
+    {
+      theta += theta < (1 << MPP_THETA_BITS) - 1;
+      tc = 0;
+    }
+    else if (tc < -tc_max - 1)
+    {
+      theta -= theta > 0;
+      tc = 0;
+    }
+  }
+
+  for (int i = 0; i < num_features; i++)
+  {
+    if (features[i].kind == MPP_GLOBAL)
+    {
+      folded_update(&fold_end[i], ghistory.bit(fold_end[i].length - 1), outcome);
+      if (fold_start[i].length > 0)
+      {
+        folded_update(&fold_start[i], ghistory.bit(fold_start[i].length - 1), outcome);
+      }
+    }
+  }
+  ghistory.push(outcome);
+
+  uint16_t *local = &lhist[(pc >> 2) & ((1 << MPP_LOCAL_BITS) - 1)];
+  *local = ((*local << 1) | outcome) & ((1 << MPP_MAX_LOCAL) - 1);
+  if (outcome)
+  {
+    push_path(target);
+  }
+}
+
+void MppPredictor::track(uint32_t pc, uint32_t target, uint32_t call, uint32_t ret, uint32_t direct)
+{
+  push_path(target);
+  follow_call(pc, call, ret);
+}
+
+void MppPredictor::push_path(uint32_t target)
+{
+  uint32_t h = rotl(path[path_head], 1) ^ (target >> 2);
+  path_head = (path_head + 1) % (2 * MPP_MAX_PATH);
+  path[path_head] = h;
+}
+
+void MppPredictor::follow_call(uint32_t pc, uint32_t call, uint32_t ret)
+{
+  if (call)
+  {
+    uint32_t h = rotl(calls[call_top % MPP_CALL_DEPTH], 1) ^ (pc >> 2);
+    call_top++;
+    calls[call_top % MPP_CALL_DEPTH] = h;
+  }
+  else if (ret && call_top > 0)
+  {
+    call_top--;
+  }
+}
+
+void MppPredictor::storage_model(const mpp_feature *features, int n, int index_bits, int weight_bits,
+                                 storage_report *r)
+{
+  int hist = 0, max_path = 0, max_local = 0, max_call = 0;
+  int64_t folds = 0;
+  for (int i = 0; i < n; i++)
+  {
+    const mpp_feature *f = &features[i];
+    int bits = f->index_bits != 0 ? f->index_bits : index_bits;
+    char name[32];
+    mpp_format_feature(f, name, sizeof(name));
+    storage_add(r, (int64_t)weight_bits << bits, "%s weights", name);
+    switch (f->kind)
+    {
+    case MPP_GLOBAL:
+      hist = f->start + f->len > hist ? f->start + f->len : hist;
+      folds += (f->start > 0 ? 2 : 1) * bits;
+      break;
+    case MPP_PATH:
+      max_path = f->len > max_path ? f->len : max_path;
+      break;
+    case MPP_LOCAL:
+      max_local = f->len > max_local ? f->len : max_local;
+      break;
+    case MPP_CALL:
+      max_call = 1;
+      break;
+    }
+  }
+  if (hist > 0)
+  {
+    storage_add(r, hist, "global history");
+    storage_add(r, folds, "folded histories");
+  }
+  if (max_path > 0)
+  {
+    storage_add(r, (int64_t)(max_path + 1) * 32, "path hashes");
+  }
+  if (max_local > 0)
+  {
+    storage_add(r, (int64_t)max_local << MPP_LOCAL_BITS, "local histories");
+  }
+  if (max_call > 0)
+  {
+    storage_add(r, (int64_t)MPP_CALL_DEPTH * 32 + storage_count_bits(MPP_CALL_DEPTH), "call stack hashes");
+  }
+  storage_add(r, MPP_THETA_BITS + MPP_TC_BITS, "threshold, its counter");
+}
+
+void MppPredictor::storage(storage_report *r)
+{
+  storage_model(features, num_features, 0, weight_bits, r);
+}
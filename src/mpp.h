@@ -0,0 +1,88 @@
+//========================================================//
+//  mpp.h                                                 //
+//  Header file for the multiperspective perceptron       //
+//                                                        //
+//  A hashed perceptron whose tables each look at the     //
+//  branch from one perspective chosen at runtime: a      //
+//  segment of global history, the path of taken          //
+//  targets, the branch's local history, the call stack   //
+//  or the pc alone, each table sized on its own          //
+//========================================================//
+
+#ifndef MPP_H
+#define MPP_H
+
+#include "predictor.h"
+
+#define MPP_MAX_HIST 1024     // global history, the end of the last segment
+#define MPP_MAX_PATH 32       // taken targets in the path history
+#define MPP_MAX_LOCAL 16      // local history bits
+#define MPP_LOCAL_BITS 6      // log2 local histories
+#define MPP_CALL_DEPTH 32     // call stack entries, deeper calls wrap
+#define MPP_MAX_CALL 16       // call sites of one feature
+#define MPP_THETA_BITS 8
+#define MPP_TC_BITS 7         // threshold adaptation counter
+
+// Returns True if 'features' can be simulated with tables of
+// 'index_bits' by default and weights of 'weight_bits', printing
+// the problem otherwise
+//
+int mpp_check_features(const mpp_feature *features, int n, int index_bits, int weight_bits);
+
+// Write 'f' in the form the features key takes to 'buf'
+//
+void mpp_format_feature(const mpp_feature *f, char *buf, size_t size);
+
+class MppPredictor : public Predictor
+{
+public:
+  MppPredictor(const mpp_feature *features, int n, int index_bits, int weight_bits);
+  ~MppPredictor();
+  uint8_t predict(uint32_t pc, uint32_t target, uint32_t direct);
+  void train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct);
+  void track(uint32_t pc, uint32_t target, uint32_t call, uint32_t ret, uint32_t direct);
+  void storage(storage_report *r);
+
+  static void storage_model(const mpp_feature *features, int n, int index_bits, int weight_bits, storage_report *r);
+
+private:
+  // Push a taken branch to 'target' into the path history
+  void push_path(uint32_t target);
+
+  // Push or pop the call stack on a call or return at 'pc'
+  void follow_call(uint32_t pc, uint32_t call, uint32_t ret);
+
+  int num_features;
+  mpp_feature features[MPP_MAX_FEATURES];  // index bits resolved
+  uint32_t offset[MPP_MAX_FEATURES];       // of each table into the weights
+  int weight_bits;
+  int wmin;
+  int wmax;
+  int8_t *weights;
+
+  // Global history and, for each segment, the folded registers of
+  // its end and its start, whose XOR folds the bits in between
+  global_history<MPP_MAX_HIST> ghistory;
+  folded_history fold_end[MPP_MAX_FEATURES];
+  folded_history fold_start[MPP_MAX_FEATURES];
+
+  // path[i] hashes every taken target so far, each rotated by its
+  // age, so the last n targets are path[i] ^ rotl(path[i - n], n)
+  uint32_t path[2 * MPP_MAX_PATH];
+  uint32_t path_head;
+
+  uint16_t lhist[1 << MPP_LOCAL_BITS];
+
+  // Hashes of the call sites up to each depth, the same way
+  uint32_t calls[MPP_CALL_DEPTH];
+  uint32_t call_top;
+
+  int theta;        // sums at most this far from 0 train
+  int tc;
+
+  // lookup of the last predict(), used by train()
+  uint32_t index[MPP_MAX_FEATURES];
+  int sum;
+};
+
+#endif
@@ -0,0 +1,272 @@
+//========================================================//
+//  parse.cpp                                             //
+//  Source file for the text trace parser                 //
+//                                                        //
+//  Each window of PARSE_WINDOW bytes is turned into bit  //
+//  masks of tabs, newlines, hex digits, decimal digits   //
+//  and non-zero digits by a scalar, SSE2 or AVX2 kernel. //
+//  Line layout is then checked and decoded from the      //
+//  masks with bit tricks, and hex fields are converted   //
+//  eight digits at a time with SWAR arithmetic           //
+//========================================================//
+#include <string.h>
+#include <immintrin.h>
+#include "parse.h"
+#include "trace.h"
+
+const char *parseKernelName[3] = {"scalar", "SSE2", "AVX2"};
+
+struct parse_masks {
+  uint64_t tab;
+  uint64_t nl;
+  uint64_t hex;
+  uint64_t dig;
+  uint64_t nz;
+};
+
+//------------------------------------//
+//          Mask Kernels              //
+//------------------------------------//
+
+static void masks_scalar(const char *p, parse_masks *m)
+{
+  m->tab = m->nl = m->hex = m->dig = m->nz = 0;
+  for (int i = 0; i < PARSE_WINDOW; i++)
+  {
+    unsigned char c = p[i];
+    unsigned char l = c | 0x20;
+    uint64_t bit = 1ULL << i;
+    m->tab |= c == '\t' ? bit : 0;
+    m->nl |= c == '\n' ? bit : 0;
+    m->hex |= (c >= '0' && c <= '9') || (l >= 'a' && l <= 'f') ? bit : 0;
+    m->dig |= c >= '0' && c <= '9' ? bit : 0;
+    m->nz |= c >= '1' && c <= '9' ? bit : 0;
+  }
+}
+
+// Bytes in [lo, hi]; all bytes of interest are ASCII so the
+// signed compares are safe
+#define SSE_RANGE(v, lo, hi) \
+  _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((lo) - 1)), _mm_cmpgt_epi8(_mm_set1_epi8((hi) + 1), v))
+
+static void masks_sse2(const char *p, parse_masks *m)
+{
+  m->tab = m->nl = m->hex = m->dig = m->nz = 0;
+  for (int i = 0; i < PARSE_WINDOW; i += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+    __m128i l = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i dig = SSE_RANGE(v, '0', '9');
+    __m128i hex = _mm_or_si128(dig, SSE_RANGE(l, 'a', 'f'));
+    m->tab |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))) << i;
+    m->nl |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))) << i;
+    m->hex |= (uint64_t)(uint16_t)_mm_movemask_epi8(hex) << i;
+    m->dig |= (uint64_t)(uint16_t)_mm_movemask_epi8(dig) << i;
+    m->nz |= (uint64_t)(uint16_t)_mm_movemask_epi8(SSE_RANGE(v, '1', '9')) << i;
+  }
+}
+
+#define AVX_RANGE(v, lo, hi) \
+  _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8((lo) - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8((hi) + 1), v))
+
+__attribute__((target("avx2"))) static void masks_avx2(const char *p, parse_masks *m)
+{
+  m->tab = m->nl = m->hex = m->dig = m->nz = 0;
+  for (int i = 0; i < PARSE_WINDOW; i += 32)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+    __m256i l = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i dig = AVX_RANGE(v, '0', '9');
+    __m256i hex = _mm256_or_si256(dig, AVX_RANGE(l, 'a', 'f'));
+    m->tab |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))) << i;
+    m->nl |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))) << i;
+    m->hex |= (uint64_t)(uint32_t)_mm256_movemask_epi8(hex) << i;
+    m->dig |= (uint64_t)(uint32_t)_mm256_movemask_epi8(dig) << i;
+    m->nz |= (uint64_t)(uint32_t)_mm256_movemask_epi8(AVX_RANGE(v, '1', '9')) << i;
+  }
+}
+
+static void (*compute_masks)(const char *p, parse_masks *m) = masks_sse2;
+
+int parse_select(int kernel)
+{
+  if (kernel == PARSE_BEST || kernel > PARSE_AVX2)
+  {
+    kernel = PARSE_AVX2;
+  }
+  if (kernel == PARSE_AVX2 && !__builtin_cpu_supports("avx2"))
+  {
+    kernel = PARSE_SSE2;
+  }
+
+  switch (kernel)
+  {
+  case PARSE_SCALAR:
+    compute_masks = masks_scalar;
+    break;
+  case PARSE_SSE2:
+    compute_masks = masks_sse2;
+    break;
+  default:
+    compute_masks = masks_avx2;
+    break;
+  }
+  return kernel;
+}
+
+//------------------------------------//
+//           Line Decoding            //
+//------------------------------------//
+
+// Bits [a, b) set
+static inline uint64_t bit_range(int a, int b)
+{
+  return ((1ULL << b) - 1) & ~((1ULL << a) - 1);
+}
+
+// Convert the 'n' (1 to 8) hex digits at 'p' without branching
+// on the digits: each byte maps to its nibble as (c & 0xF) plus
+// 9 for letters, then the nibbles are reversed and packed
+//
+static inline uint32_t parse_hex(const char *p, int n)
+{
+  uint64_t x;
+  memcpy(&x, p, 8);
+  uint64_t v = (x & 0x0F0F0F0F0F0F0F0FULL) + ((x >> 6) & 0x0101010101010101ULL) * 9;
+  v = __builtin_bswap64(v) >> (8 * (8 - n));
+  v = (v | (v >> 4)) & 0x00FF00FF00FF00FFULL;
+  v = (v | (v >> 8)) & 0x0000FFFF0000FFFFULL;
+  v = (v | (v >> 16)) & 0x00000000FFFFFFFFULL;
+  return (uint32_t)v;
+}
+
+// Decode the line at 'p' from its masks. 'e' is the offset of its
+// newline, which the caller has found within the window, and may
+// follow a carriage return
+//
+// Returns True if the line is well formed
+//
+static inline int parse_line(const char *p, const parse_masks *m, int e, branch_batch *out)
+{
+  if (e > 0 && p[e - 1] == '\r')
+  {
+    e--;
+  }
+  uint64_t tabs = m->tab & ((1ULL << e) - 1);
+  if (__builtin_popcountll(tabs) != 6)
+  {
+    return 0;
+  }
+
+  int t[7];
+  for (int i = 0; i < 6; i++)
+  {
+    t[i] = __builtin_ctzll(tabs);
+    tabs &= tabs - 1;
+  }
+  t[6] = e;
+
+  int n1 = t[0] - 2;
+  int n2 = t[1] - t[0] - 3;
+  uint64_t bad = (uint64_t)(p[0] != '0') | (p[1] != 'x') | (p[t[0] + 1] != '0') | (p[t[0] + 2] != 'x') |
+                 (uint64_t)(n1 < 1 || n1 > 8 || n2 < 1 || n2 > 8);
+  bad |= bit_range(2, t[0]) & ~m->hex;
+  bad |= bit_range(t[0] + 3, t[1]) & ~m->hex;
+
+  // Decimal fields must be non-empty runs of digits; a field is
+  // set when any of its digits is non-zero
+  uint8_t flags = 0;
+  for (int i = 1; i < 6; i++)
+  {
+    uint64_t field = bit_range(t[i] + 1, t[i + 1]);
+    bad |= (uint64_t)(field == 0) | (field & ~m->dig);
+    flags |= (uint8_t)(((field & m->nz) != 0) << (i - 1));
+  }
+  if (bad)
+  {
+    return 0;
+  }
+
+  out->pc[out->count] = parse_hex(p + 2, n1);
+  out->target[out->count] = parse_hex(p + t[0] + 3, n2);
+  out->flags[out->count] = flags;
+  out->count++;
+  return 1;
+}
+
+static inline void shift_masks(parse_masks *m, int n)
+{
+  if (n >= 64)
+  {
+    m->tab = m->nl = m->hex = m->dig = m->nz = 0;
+    return;
+  }
+  m->tab >>= n;
+  m->nl >>= n;
+  m->hex >>= n;
+  m->dig >>= n;
+  m->nz >>= n;
+}
+
+static inline void count_malformed(parse_stats *stats)
+{
+  if (stats->malformed++ == 0)
+  {
+    stats->first_malformed = stats->lines;
+  }
+}
+
+size_t parse_lines(const char **pos, const char *end, branch_batch *out, parse_stats *stats)
+{
+  const char *p = *pos;
+  size_t start = out->count;
+  char tail[PARSE_PAD];
+
+  while (out->count < TRACE_BATCH && p < end)
+  {
+    // Near the end of the buffer work on a zero padded copy
+    size_t avail = end - p;
+    const char *w = p;
+    if (avail < PARSE_PAD)
+    {
+      memset(tail, 0, sizeof(tail));
+      memcpy(tail, p, avail < PARSE_WINDOW ? avail : PARSE_WINDOW);
+      w = tail;
+    }
+
+    parse_masks m;
+    compute_masks(w, &m);
+    if (m.nl == 0)
+    {
+      // Either the line is still incomplete, or it is longer
+      // than any well formed line and gets skipped
+      const char *nl = avail < PARSE_WINDOW ? NULL : (const char *)memchr(p, '\n', avail);
+      if (nl == NULL)
+      {
+        break;
+      }
+      stats->lines++;
+      count_malformed(stats);
+      p = nl + 1;
+      continue;
+    }
+
+    // Decode every line that ends inside this window
+    int used = 0;
+    while (m.nl != 0 && out->count < TRACE_BATCH)
+    {
+      int e = __builtin_ctzll(m.nl);
+      stats->lines++;
+      if (!parse_line(w + used, &m, e, out))
+      {
+        count_malformed(stats);
+      }
+      used += e + 1;
+      shift_masks(&m, e + 1);
+    }
+    p += used;
+  }
+
+  *pos = p;
+  return out->count - start;
+}
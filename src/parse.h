@@ -0,0 +1,54 @@
+//========================================================//
+//  parse.h                                               //
+//  Header file for the text trace parser                 //
+//                                                        //
+//  Parses lines of the fixed extractor format            //
+//    0x<pc>\t0x<target>\t<o>\t<c>\t<call>\t<ret>\t<dir>  //
+//  many at a time, finding delimiters with SIMD masks    //
+//  instead of going through sscanf                       //
+//========================================================//
+
+#ifndef PARSE_H
+#define PARSE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct branch_batch;
+
+// Bytes past the start of a line the parser may read. Buffers
+// whose last line ends closer than this to their end are
+// handled by copying that tail
+#define PARSE_WINDOW 64
+#define PARSE_PAD (PARSE_WINDOW + 8)
+
+// Delimiter scanning kernels
+#define PARSE_SCALAR 0
+#define PARSE_SSE2 1
+#define PARSE_AVX2 2
+#define PARSE_BEST -1
+extern const char *parseKernelName[];
+
+struct parse_stats {
+  uint64_t lines;           // lines consumed, malformed ones included
+  uint64_t malformed;       // lines skipped as malformed
+  uint64_t first_malformed; // 1-based number of the first one, 0 if none
+};
+
+// Select the delimiter scanning kernel, falling back to the
+// best one the CPU supports
+//
+// Returns the kernel actually selected
+//
+int parse_select(int kernel);
+
+// Parse complete lines from [*pos, end), appending records to
+// 'out' until it is full. Malformed lines are skipped and
+// counted in 'stats'. Stops in front of a trailing line that
+// has no newline yet, leaving *pos at its start
+//
+// Returns the number of records appended
+//
+size_t parse_lines(const char **pos, const char *end, branch_batch *out, parse_stats *stats);
+
+#endif
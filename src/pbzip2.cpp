@@ -0,0 +1,479 @@
+//========================================================//
+//  pbzip2.cpp                                            //
+//  Source file for the parallel bzip2 source             //
+//                                                        //
+//  A bzip2 stream is a run of independently coded        //
+//  blocks, each starting with a bit aligned 48-bit       //
+//  magic. The file is scanned for block boundaries,      //
+//  every block is rewrapped as a one-block stream and    //
+//  decoded on a pool of worker threads, and the results  //
+//  are handed to the parser strictly in file order       //
+//========================================================//
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <bzlib.h>
+#include "source.h"
+
+// Magics in front of each block and at the end of each stream
+#define BZIP2_BLOCK_MAGIC 0x314159265359ULL
+#define BZIP2_EOS_MAGIC 0x177245385090ULL
+#define BZIP2_MAGIC_BITS 48
+
+// Most blocks a failing block is joined with before giving up
+#define BZIP2_MAX_MERGE 4
+
+// Block states
+#define BLOCK_PENDING 0
+#define BLOCK_DONE 1
+#define BLOCK_FAILED 2
+
+struct bzip2_block {
+  uint64_t start; // bit offset of the block magic
+  uint64_t end;   // bit offset one past the block
+  unsigned char level;
+  uint32_t crc;        // CRC of the block, from its header
+  int stream_end;      // last block of its stream
+  uint32_t stream_crc; // combined CRC stored at the end of the stream
+  int state;
+  char *data;
+  size_t len;
+};
+
+struct pbzip2_source {
+  chunk_source base;
+  unsigned char *map;
+  size_t size;
+
+  bzip2_block *blocks;
+  int num_blocks;
+
+  // Workers decode at most 'window' blocks ahead of the
+  // parser to bound the memory held by decoded blocks
+  pthread_t *workers;
+  int threads;
+  int window;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int next_job;
+  int emit;
+  int held;
+  int stop;
+
+  // Combined CRC of the blocks of the current stream handed out
+  // so far, checked against the stored one at the stream end
+  uint32_t combined_crc;
+};
+
+//------------------------------------//
+//          Block Boundaries          //
+//------------------------------------//
+
+static uint32_t get_bits32(const unsigned char *in, uint64_t pos)
+{
+  uint32_t v = 0;
+  for (int i = 0; i < 32; i++, pos++)
+  {
+    v = (v << 1) | ((in[pos >> 3] >> (7 - (pos & 7))) & 1);
+  }
+  return v;
+}
+
+static void pbzip2_add_block(pbzip2_source *p, uint64_t start, unsigned char level, int *cap)
+{
+  if (p->num_blocks == *cap)
+  {
+    *cap = *cap ? 2 * *cap : 64;
+    p->blocks = (bzip2_block *)realloc(p->blocks, *cap * sizeof(bzip2_block));
+  }
+  bzip2_block *b = &p->blocks[p->num_blocks++];
+  memset(b, 0, sizeof(*b));
+  b->start = start;
+  b->level = level;
+}
+
+// Find every block of every stream in the file. Anything
+// after the last stream is ignored, as bunzip2 does
+//
+// Returns True if Successful
+//
+static int pbzip2_scan(pbzip2_source *p)
+{
+  const unsigned char *m = p->map;
+  const uint64_t mask = (1ULL << BZIP2_MAGIC_BITS) - 1;
+  int cap = 0;
+  int streams = 0;
+  size_t pos = 0;
+
+  while (pos < p->size && source_is_bzip2(m + pos, p->size - pos))
+  {
+    unsigned char level = m[pos + 3];
+    int open = 0;
+    int ended = 0;
+    uint64_t r = 0;
+    pos += 4;
+
+    for (size_t i = pos; i < p->size && !ended; i++)
+    {
+      r = (r << 8) | m[i];
+      uint64_t seen = (uint64_t)(i + 1 - pos) * 8;
+      for (int k = 7; k >= 0 && !ended; k--)
+      {
+        if (seen < BZIP2_MAGIC_BITS + (uint64_t)k)
+        {
+          continue;
+        }
+        uint64_t v = (r >> k) & mask;
+        if (v != BZIP2_BLOCK_MAGIC && v != BZIP2_EOS_MAGIC)
+        {
+          continue;
+        }
+        uint64_t bit = (uint64_t)(i + 1) * 8 - k - BZIP2_MAGIC_BITS;
+        if (bit + BZIP2_MAGIC_BITS + 32 > (uint64_t)p->size * 8)
+        {
+          // Too close to the end of the file for the CRC
+          continue;
+        }
+        uint32_t crc = get_bits32(m, bit + BZIP2_MAGIC_BITS);
+        if (open)
+        {
+          p->blocks[p->num_blocks - 1].end = bit;
+        }
+        if (v == BZIP2_BLOCK_MAGIC)
+        {
+          pbzip2_add_block(p, bit, level, &cap);
+          p->blocks[p->num_blocks - 1].crc = crc;
+          open = 1;
+        }
+        else
+        {
+          // The stream CRC follows, then padding to a byte
+          ended = 1;
+          pos = (bit + BZIP2_MAGIC_BITS + 32 + 7) / 8;
+          if (open)
+          {
+            p->blocks[p->num_blocks - 1].stream_end = 1;
+            p->blocks[p->num_blocks - 1].stream_crc = crc;
+          }
+          else if (crc != 0)
+          {
+            return 0;
+          }
+        }
+      }
+    }
+    if (!ended)
+    {
+      return 0;
+    }
+    streams++;
+  }
+  return streams > 0;
+}
+
+//------------------------------------//
+//           Block Decoding           //
+//------------------------------------//
+
+// Write the low 'n' bits of 'value' MSB first at bit 'pos' of 'out'
+//
+static void put_bits(unsigned char *out, uint64_t pos, uint64_t value, int n)
+{
+  for (int i = n - 1; i >= 0; i--, pos++)
+  {
+    if ((value >> i) & 1)
+    {
+      out[pos >> 3] |= 0x80 >> (pos & 7);
+    }
+  }
+}
+
+// Decode the bits [start, end) of the file, which should hold
+// exactly one block, by wrapping them into a one-block stream
+// whose combined CRC is the CRC of that block
+//
+// Returns True if Successful
+//
+static int pbzip2_decode(pbzip2_source *p, uint64_t start, uint64_t end, unsigned char level, char **data, size_t *len)
+{
+  uint64_t nbits = end - start;
+  size_t in_len = 4 + (nbits + BZIP2_MAGIC_BITS + 32 + 7) / 8;
+  unsigned char *in = (unsigned char *)calloc(in_len, 1);
+  in[0] = 'B';
+  in[1] = 'Z';
+  in[2] = 'h';
+  in[3] = level;
+
+  // Shift the block onto a byte boundary
+  const unsigned char *src = p->map + (start >> 3);
+  int shift = start & 7;
+  size_t whole = nbits >> 3;
+  for (size_t i = 0; i < whole; i++)
+  {
+    in[4 + i] = shift ? (unsigned char)((src[i] << shift) | (src[i + 1] >> (8 - shift))) : src[i];
+  }
+  for (uint64_t b = whole * 8; b < nbits; b++)
+  {
+    uint64_t pos = start + b;
+    if ((p->map[pos >> 3] >> (7 - (pos & 7))) & 1)
+    {
+      in[4 + (b >> 3)] |= 0x80 >> (b & 7);
+    }
+  }
+  uint32_t crc = get_bits32(p->map, start + BZIP2_MAGIC_BITS);
+  put_bits(in, 32 + nbits, BZIP2_EOS_MAGIC, BZIP2_MAGIC_BITS);
+  put_bits(in, 32 + nbits + BZIP2_MAGIC_BITS, crc, 32);
+
+  bz_stream strm;
+  memset(&strm, 0, sizeof(strm));
+  if (BZ2_bzDecompressInit(&strm, 0, 0) != BZ_OK)
+  {
+    free(in);
+    return 0;
+  }
+  size_t cap = (size_t)(level - '0') * 100000 + 1;
+  char *out = (char *)malloc(cap + 1);
+  strm.next_in = (char *)in;
+  strm.avail_in = in_len;
+  strm.next_out = out;
+  strm.avail_out = cap;
+
+  int ret;
+  while ((ret = BZ2_bzDecompress(&strm)) == BZ_OK)
+  {
+    if (strm.avail_out > 0)
+    {
+      // All input consumed without reaching the stream end
+      break;
+    }
+    size_t used = cap;
+    cap *= 2;
+    out = (char *)realloc(out, cap + 1);
+    strm.next_out = out + used;
+    strm.avail_out = cap - used;
+  }
+  size_t used = cap - strm.avail_out;
+  BZ2_bzDecompressEnd(&strm);
+  free(in);
+
+  if (ret != BZ_STREAM_END)
+  {
+    free(out);
+    return 0;
+  }
+  out[used] = '\0';
+  *data = out;
+  *len = used;
+  return 1;
+}
+
+static void *pbzip2_worker(void *arg)
+{
+  pbzip2_source *p = (pbzip2_source *)arg;
+  pthread_mutex_lock(&p->lock);
+  while (!p->stop)
+  {
+    if (p->next_job < p->num_blocks && p->next_job < p->emit + p->window)
+    {
+      bzip2_block *b = &p->blocks[p->next_job++];
+      pthread_mutex_unlock(&p->lock);
+
+      char *data = NULL;
+      size_t len = 0;
+      int ok = pbzip2_decode(p, b->start, b->end, b->level, &data, &len);
+
+      pthread_mutex_lock(&p->lock);
+      b->data = data;
+      b->len = len;
+      b->state = ok ? BLOCK_DONE : BLOCK_FAILED;
+      pthread_cond_broadcast(&p->cond);
+      continue;
+    }
+    pthread_cond_wait(&p->cond, &p->lock);
+  }
+  pthread_mutex_unlock(&p->lock);
+  return NULL;
+}
+
+//------------------------------------//
+//          Ordered Delivery          //
+//------------------------------------//
+
+// Fold the 'n' blocks from 'first' into the combined CRC of their
+// stream, as they are handed out
+//
+// Returns False if they end a stream whose stored CRC disagrees,
+// as when a false end of stream magic cut the stream short
+//
+static int pbzip2_check_crc(pbzip2_source *p, int first, int n)
+{
+  const bzip2_block *b = &p->blocks[first];
+  p->combined_crc = ((p->combined_crc << 1) | (p->combined_crc >> 31)) ^ b->crc;
+  const bzip2_block *last = &p->blocks[first + n - 1];
+  if (!last->stream_end)
+  {
+    return 1;
+  }
+  int ok = p->combined_crc == last->stream_crc;
+  p->combined_crc = 0;
+  return ok;
+}
+
+// Wait for block 'i' to leave the workers. Called with the lock held
+//
+static void pbzip2_wait(pbzip2_source *p, int i)
+{
+  while (p->blocks[i].state == BLOCK_PENDING)
+  {
+    pthread_cond_wait(&p->cond, &p->lock);
+  }
+}
+
+static int pbzip2_next(chunk_source *src, char **data, size_t *len)
+{
+  pbzip2_source *p = (pbzip2_source *)src;
+  pthread_mutex_lock(&p->lock);
+
+  // Give back the block(s) handed out last time
+  for (int i = 0; i < p->held; i++)
+  {
+    pbzip2_wait(p, p->emit);
+    free(p->blocks[p->emit].data);
+    p->blocks[p->emit].data = NULL;
+    p->emit++;
+  }
+  p->held = 0;
+  pthread_cond_broadcast(&p->cond);
+
+  if (p->emit >= p->num_blocks || src->error)
+  {
+    pthread_mutex_unlock(&p->lock);
+    return 0;
+  }
+
+  bzip2_block *b = &p->blocks[p->emit];
+  pbzip2_wait(p, p->emit);
+  if (b->state == BLOCK_DONE)
+  {
+    if (!pbzip2_check_crc(p, p->emit, 1))
+    {
+      src->error = 1;
+      pthread_mutex_unlock(&p->lock);
+      return 0;
+    }
+    *data = b->data;
+    *len = b->len;
+    p->held = 1;
+    pthread_mutex_unlock(&p->lock);
+    return 1;
+  }
+  pthread_mutex_unlock(&p->lock);
+
+  // A block that fails to decode was cut short by a false magic
+  // inside its compressed data. Join it with its successors
+  // until the combined bits decode
+  for (int j = p->emit + 1; j < p->num_blocks && j <= p->emit + BZIP2_MAX_MERGE; j++)
+  {
+    char *merged;
+    size_t merged_len;
+    if (pbzip2_decode(p, b->start, p->blocks[j].end, b->level, &merged, &merged_len))
+    {
+      pthread_mutex_lock(&p->lock);
+      free(b->data);
+      b->data = merged;
+      b->len = merged_len;
+      p->held = j - p->emit + 1;
+      int ok = pbzip2_check_crc(p, p->emit, p->held);
+      pthread_mutex_unlock(&p->lock);
+      if (!ok)
+      {
+        src->error = 1;
+        return 0;
+      }
+      *data = merged;
+      *len = merged_len;
+      return 1;
+    }
+  }
+  src->error = 1;
+  return 0;
+}
+
+static void pbzip2_close(chunk_source *src)
+{
+  pbzip2_source *p = (pbzip2_source *)src;
+  pthread_mutex_lock(&p->lock);
+  p->stop = 1;
+  pthread_cond_broadcast(&p->cond);
+  pthread_mutex_unlock(&p->lock);
+  for (int i = 0; i < p->threads; i++)
+  {
+    pthread_join(p->workers[i], NULL);
+  }
+
+  pthread_mutex_destroy(&p->lock);
+  pthread_cond_destroy(&p->cond);
+  for (int i = 0; i < p->num_blocks; i++)
+  {
+    free(p->blocks[i].data);
+  }
+  free(p->blocks);
+  free(p->workers);
+  munmap(p->map, p->size);
+  free(p);
+}
+
+chunk_source *pbzip2_source_open(int fd, int threads)
+{
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+  {
+    return NULL;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED)
+  {
+    return NULL;
+  }
+
+  pbzip2_source *p = (pbzip2_source *)calloc(1, sizeof(pbzip2_source));
+  p->base.next = pbzip2_next;
+  p->base.close = pbzip2_close;
+  p->map = (unsigned char *)map;
+  p->size = st.st_size;
+  if (!pbzip2_scan(p))
+  {
+    // Not a complete bzip2 file; report it once the parser reads
+    p->base.error = 1;
+    p->num_blocks = 0;
+  }
+
+  if (threads <= 0)
+  {
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  p->threads = threads > 0 ? threads : 1;
+  p->window = 2 * p->threads + SOURCE_RING_SLOTS;
+  p->workers = (pthread_t *)calloc(p->threads, sizeof(pthread_t));
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->cond, NULL);
+  for (int i = 0; i < p->threads; i++)
+  {
+    if (pthread_create(&p->workers[i], NULL, pbzip2_worker, p) != 0)
+    {
+      p->threads = i;
+      break;
+    }
+  }
+  if (p->threads == 0)
+  {
+    pbzip2_close(&p->base);
+    return NULL;
+  }
+  close(fd);
+  return &p->base;
+}
@@ -0,0 +1,132 @@
+//========================================================//
+//  perceptron.cpp                                        //
+//  Source file for the hashed perceptron predictor       //
+//                                                        //
+//  Weights are summed and trained with plain loads, one  //
+//  per table. Table indices follow the history through   //
+//  folded registers, O(1) per branch                     //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "perceptron.h"
+
+//------------------------------------//
+//            Predictor               //
+//------------------------------------//
+
+PerceptronPredictor::PerceptronPredictor(int num_tables, int table_bits, int hist_len, int weight_bits)
+{
+  this->num_tables = num_tables;
+  this->table_bits = table_bits;
+  this->hist_len = hist_len;
+  this->weight_bits = weight_bits;
+  wmax = (1 << (weight_bits - 1)) - 1;
+  wmin = -wmax - 1;
+
+  // the first table is indexed by the pc alone
+  memset(table_hist_len, 0, sizeof(table_hist_len));
+  if (num_tables > 1)
+  {
+    geometric_history_lengths(num_tables - 1, PERCEPTRON_MIN_HIST < hist_len ? PERCEPTRON_MIN_HIST : 1, hist_len,
+                              &table_hist_len[1]);
+  }
+
+  weights = (int8_t *)calloc((size_t)num_tables << table_bits, 1);
+
+  ghistory.clear();
+  memset(fold, 0, sizeof(fold));
+  for (int i = 1; i < num_tables; i++)
+  {
+    folded_init(&fold[i], table_hist_len[i], table_bits);
+  }
+  path = 0;
+  theta = num_tables;
+  tc = 0;
+  memset(&ctx, 0, sizeof(ctx));
+}
+
+PerceptronPredictor::~PerceptronPredictor()
+{
+  free(weights);
+}
+
+uint8_t PerceptronPredictor::predict(uint32_t pc, uint32_t target, uint32_t direct)
+{
+  uint32_t mask = (1 << table_bits) - 1;
+  uint32_t p = pc >> 2;
+  ctx.offset[0] = p & mask;
+  for (int i = 1; i < num_tables; i++)
+  {
+    int path_len = table_hist_len[i] < PERCEPTRON_PATH_BITS ? table_hist_len[i] : PERCEPTRON_PATH_BITS;
+    uint32_t path_bits = path & ((1 << path_len) - 1);
+    uint32_t index = (p ^ (p >> table_bits) ^ fold[i].comp ^ (path_bits << 1) ^ i) & mask;
+    ctx.offset[i] = ((uint32_t)i << table_bits) + index;
+  }
+
+  ctx.sum = 0;
+  for (int i = 0; i < num_tables; i++)
+  {
+    ctx.sum += weights[ctx.offset[i]];
+  }
+  return ctx.sum >= 0 ? TAKEN : NOTTAKEN;
+}
+
+void PerceptronPredictor::train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct)
+{
+  uint8_t pred = ctx.sum >= 0 ? TAKEN : NOTTAKEN;
+  int abs_sum = ctx.sum < 0 ? -ctx.sum : ctx.sum;
+
+  // Train on mispredictions and sums within theta, and move theta
+  // so both happen about as often
+  if (pred != outcome || abs_sum <= theta)
+  {
+    for (int i = 0; i < num_tables; i++)
+    {
+      int8_t *w = &weights[ctx.offset[i]];
+      if (outcome)
+      {
+        *w += *w < wmax;
+      }
+      else
+      {
+        *w -= *w > wmin;
+      }
+    }
+
+    int tc_max = (1 << (PERCEPTRON_TC_BITS - 1)) - 1;
+    tc += pred != outcome ? 1 : -1;
+    if (tc > tc_max)
+    {
+      theta += theta < (1 << PERCEPTRON_THETA_BITS) - 1;
+      tc = 0;
+    }
+    else if (tc < -tc_max - 1)
+    {
+      theta -= theta > 0;
+      tc = 0;
+    }
+  }
+
+  for (int i = 1; i < num_tables; i++)
+  {
+    folded_update(&fold[i], ghistory.bit(table_hist_len[i] - 1), outcome);
+  }
+  ghistory.push(outcome);
+  path = ((path << 1) | ((pc >> 2) & 1)) & ((1 << PERCEPTRON_PATH_BITS) - 1);
+}
+
+void PerceptronPredictor::storage_model(int num_tables, int table_bits, int hist_len, int weight_bits,
+                                        storage_report *r)
+{
+  storage_add(r, ((int64_t)num_tables * weight_bits) << table_bits, "weight tables");
+  storage_add(r, hist_len, "global history");
+  storage_add(r, (int64_t)(num_tables - 1) * table_bits, "folded histories");
+  storage_add(r, PERCEPTRON_PATH_BITS, "path history");
+  storage_add(r, PERCEPTRON_THETA_BITS + PERCEPTRON_TC_BITS, "threshold, its counter");
+}
+
+void PerceptronPredictor::storage(storage_report *r)
+{
+  storage_model(num_tables, table_bits, hist_len, weight_bits, r);
+}
@@ -0,0 +1,61 @@
+//========================================================//
+//  perceptron.h                                          //
+//  Header file for the hashed perceptron predictor       //
+//                                                        //
+//  Each table holds signed weights indexed by a hash of  //
+//  the pc with a global history of its own length, the   //
+//  lengths growing geometrically. The prediction is the  //
+//  sign of the sum of one weight from every table        //
+//========================================================//
+
+#ifndef PERCEPTRON_H
+#define PERCEPTRON_H
+
+#include "predictor.h"
+
+#define PERCEPTRON_MAX_TABLES 32
+#define PERCEPTRON_MAX_HIST 1024  // longest global history
+#define PERCEPTRON_MIN_HIST 3     // history of the first table past the bias table
+#define PERCEPTRON_PATH_BITS 16   // path history: a pc bit of each recent branch, not its target
+#define PERCEPTRON_THETA_BITS 8
+#define PERCEPTRON_TC_BITS 7      // threshold adaptation counter
+
+// What the lookup of one branch found, for its training: the
+// weight picked from each table as an offset into the weights
+struct perceptron_context {
+  uint32_t offset[PERCEPTRON_MAX_TABLES];
+  int sum;
+};
+
+class PerceptronPredictor : public Predictor
+{
+public:
+  PerceptronPredictor(int num_tables, int table_bits, int hist_len, int weight_bits);
+  ~PerceptronPredictor();
+  uint8_t predict(uint32_t pc, uint32_t target, uint32_t direct);
+  void train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct);
+  void storage(storage_report *r);
+
+  static void storage_model(int num_tables, int table_bits, int hist_len, int weight_bits, storage_report *r);
+
+private:
+  int num_tables;
+  int table_bits;
+  int hist_len;
+  int weight_bits;
+  int wmin;
+  int wmax;
+  int table_hist_len[PERCEPTRON_MAX_TABLES]; // 0 for the bias table
+
+  int8_t *weights;  // table i at offset i << table_bits
+  global_history<PERCEPTRON_MAX_HIST> ghistory;
+  folded_history fold[PERCEPTRON_MAX_TABLES];
+  uint32_t path;
+  int theta;        // sums at most this far from 0 train
+  int tc;
+
+  // lookup of the last predict(), used by train()
+  perceptron_context ctx;
+};
+
+#endif
@@ -0,0 +1,237 @@
+//========================================================//
+//  pipeline.cpp                                          //
+//  Source file for the pipelined trace reader            //
+//                                                        //
+//  The I/O stage reads a text file straight into a ring  //
+//  of chunk slots, the parser stage reads those through  //
+//  a stand-in chunk source and fills a ring of batches,  //
+//  and the caller consumes the batches. Slots circulate  //
+//  between stages through pairs of lock-free SPSC        //
+//  queues (full and free), so no chunk is copied. The    //
+//  decompressors fill chunks on threads of their own,    //
+//  which take the place of the I/O stage                 //
+//========================================================//
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "pipeline.h"
+#include "spsc.h"
+
+struct pipeline {
+  // Stand-in source the parser stage reads chunks from
+  chunk_source base;
+  chunk_source *inner;
+  trace_t *trace;
+  std::atomic<int> stop;
+
+  // I/O -> parser. A slot of length 0 marks the end of input
+  int has_io;
+  pthread_t io_thread;
+  char *chunk_data[PIPELINE_CHUNKS];
+  size_t chunk_len[PIPELINE_CHUNKS];
+  spsc_queue<int, PIPELINE_CHUNKS> chunk_free;
+  spsc_queue<int, PIPELINE_CHUNKS> chunk_full;
+  int held_chunk;
+  int io_done;
+
+  // parser -> simulation. A batch of 0 records marks the end
+  pthread_t parse_thread;
+  branch_batch *batches;
+  spsc_queue<int, PIPELINE_BATCHES> batch_free;
+  spsc_queue<int, PIPELINE_BATCHES> batch_full;
+  int held_batch;
+  int parse_done;
+};
+
+// Blocking queue operations. Return False if the pipeline is
+// being stopped
+//
+template <typename Q>
+static int wait_pop(pipeline *p, Q *q, int *v)
+{
+  int spins = 0;
+  while (!q->pop(v))
+  {
+    if (p->stop.load(std::memory_order_relaxed))
+    {
+      return 0;
+    }
+    spsc_backoff(&spins);
+  }
+  return 1;
+}
+
+template <typename Q>
+static int wait_push(pipeline *p, Q *q, int v)
+{
+  int spins = 0;
+  while (!q->push(v))
+  {
+    if (p->stop.load(std::memory_order_relaxed))
+    {
+      return 0;
+    }
+    spsc_backoff(&spins);
+  }
+  return 1;
+}
+
+//------------------------------------//
+//           I/O Stage                //
+//------------------------------------//
+
+static void *pipeline_io(void *arg)
+{
+  pipeline *p = (pipeline *)arg;
+  int slot;
+  size_t len;
+  do
+  {
+    if (!wait_pop(p, &p->chunk_free, &slot))
+    {
+      return NULL;
+    }
+    len = p->inner->read(p->inner, p->chunk_data[slot], SOURCE_CHUNK_SIZE);
+    p->chunk_data[slot][len] = '\0';
+    p->chunk_len[slot] = len;
+    if (!wait_push(p, &p->chunk_full, slot))
+    {
+      return NULL;
+    }
+  } while (len > 0);
+  return NULL;
+}
+
+static int pipeline_source_next(chunk_source *src, char **data, size_t *len)
+{
+  pipeline *p = (pipeline *)src;
+  if (p->held_chunk >= 0)
+  {
+    wait_push(p, &p->chunk_free, p->held_chunk);
+    p->held_chunk = -1;
+  }
+
+  int slot;
+  if (p->io_done || !wait_pop(p, &p->chunk_full, &slot))
+  {
+    return 0;
+  }
+  if (p->chunk_len[slot] == 0)
+  {
+    p->io_done = 1;
+    src->error = p->inner->error;
+    return 0;
+  }
+  p->held_chunk = slot;
+  *data = p->chunk_data[slot];
+  *len = p->chunk_len[slot];
+  return 1;
+}
+
+//------------------------------------//
+//          Parser Stage              //
+//------------------------------------//
+
+static void *pipeline_parse(void *arg)
+{
+  pipeline *p = (pipeline *)arg;
+  int slot;
+  while (wait_pop(p, &p->batch_free, &slot))
+  {
+    size_t n = trace_read_batch(p->trace, &p->batches[slot]);
+    if (!wait_push(p, &p->batch_full, slot) || n == 0)
+    {
+      break;
+    }
+  }
+  return NULL;
+}
+
+//------------------------------------//
+//         Simulation Stage           //
+//------------------------------------//
+
+branch_batch *pipeline_next(pipeline *p)
+{
+  if (p->held_batch >= 0)
+  {
+    p->batch_free.push(p->held_batch);
+    p->held_batch = -1;
+  }
+
+  int slot;
+  if (p->parse_done || !wait_pop(p, &p->batch_full, &slot))
+  {
+    return NULL;
+  }
+  if (p->batches[slot].count == 0)
+  {
+    p->parse_done = 1;
+    return NULL;
+  }
+  p->held_batch = slot;
+  return &p->batches[slot];
+}
+
+pipeline *pipeline_start(trace_t *t)
+{
+  pipeline *p = new pipeline;
+  memset(&p->base, 0, sizeof(p->base));
+  p->base.next = pipeline_source_next;
+  p->trace = t;
+  p->inner = t->source;
+  p->stop.store(0);
+  p->held_chunk = -1;
+  p->held_batch = -1;
+  p->io_done = 0;
+  p->parse_done = 0;
+
+  p->chunk_free.init();
+  p->chunk_full.init();
+  p->batch_free.init();
+  p->batch_full.init();
+  for (int i = 0; i < PIPELINE_CHUNKS; i++)
+  {
+    p->chunk_data[i] = NULL;
+  }
+
+  // Binary traces are mapped and compressed ones decompressed on
+  // their own threads, so only text files need an I/O stage
+  p->has_io = t->format == TRACE_TEXT && t->source->read != NULL;
+  if (p->has_io)
+  {
+    for (int i = 0; i < PIPELINE_CHUNKS; i++)
+    {
+      p->chunk_data[i] = (char *)malloc(SOURCE_CHUNK_SIZE + 1);
+      p->chunk_free.push(i);
+    }
+    t->source = &p->base;
+    pthread_create(&p->io_thread, NULL, pipeline_io, p);
+  }
+
+  p->batches = (branch_batch *)malloc(PIPELINE_BATCHES * sizeof(branch_batch));
+  for (int i = 0; i < PIPELINE_BATCHES; i++)
+  {
+    p->batch_free.push(i);
+  }
+  pthread_create(&p->parse_thread, NULL, pipeline_parse, p);
+  return p;
+}
+
+void pipeline_stop(pipeline *p)
+{
+  p->stop.store(1);
+  pthread_join(p->parse_thread, NULL);
+  if (p->has_io)
+  {
+    pthread_join(p->io_thread, NULL);
+    p->trace->source = p->inner;
+  }
+
+  for (int i = 0; i < PIPELINE_CHUNKS; i++)
+  {
+    free(p->chunk_data[i]);
+  }
+  free(p->batches);
+  delete p;
+}
@@ -0,0 +1,37 @@
+//========================================================//
+//  pipeline.h                                            //
+//  Header file for the pipelined trace reader            //
+//                                                        //
+//  Splits reading into stages on their own threads:      //
+//  I/O and decompression, then parsing into batches,     //
+//  with the caller predicting as the last stage          //
+//========================================================//
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "trace.h"
+
+// Chunks between the I/O and parser stages
+#define PIPELINE_CHUNKS 4
+
+// Batches between the parser and simulation stages
+#define PIPELINE_BATCHES 8
+
+struct pipeline;
+
+// Start reading 't' on the pipeline threads. 't' must not be
+// used directly until pipeline_stop()
+//
+pipeline *pipeline_start(trace_t *t);
+
+// Return the next batch of the trace, giving back the previous
+// one, or NULL at the end
+//
+branch_batch *pipeline_next(pipeline *p);
+
+// Join the pipeline threads. 't' can then be checked and closed
+//
+void pipeline_stop(pipeline *p);
+
+#endif
@@ -6,8 +6,16 @@
 //  described in the README                               //
 //========================================================//
 #include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
 #include <math.h>
 #include "predictor.h"
+#include "tage.h"
+#include "tage_scl.h"
+#include "loop.h"
+#include "perceptron.h"
+#include "mpp.h"
+#include "ittage.h"
 
 //
 // TODO:Student Information
@@ -21,185 +29,602 @@ const char *email = "adkamat@ucsd.edu";
 //------------------------------------//
 
 // Handy Global for use in output routines
-const char *bpName[4] = {"Static", "Gshare",
-                         "Tournament", "Custom"};
+const char *bpName[NUM_BP_TYPES] = {"Static", "Gshare",
+                                   "Tournament", "Custom", "TAGE-SC-L",
+                                   "Perceptron", "Multiperspective"};
 
 // define number of bits required for indexing the BHT here.
 int ghistoryBits = 15; // Number of bits used for Global History
 int bpType;            // Branch Prediction Type
 int verbose;
 
-//------------------------------------//
-//      Predictor Data Structures     //
-//------------------------------------//
-
-//
-// TODO: Add your own Branch Predictor data structures here
-//
-// gshare
-uint8_t *bht_gshare;
-uint64_t ghistory;
-
 //tournament
-uint64_t tnmt_ghistory;
 int tnmt_global_bits = 13;
 int lhistoryBits =11;
 int lptbits=11;
 int choicebits=13;
-uint64_t *lhr_tnmt;
-uint8_t *lpt_tnmt;
-uint8_t *ghr_tnmt;
-uint8_t *cpt_tnmt;
-uint8_t global_pred=WN;
-uint8_t local_pred=NTT;
-uint8_t choice=WN;
-//ghr size = 2^13 x2 bits= 16KB
-//lhr size = 2^11 x11 bits= 22KB
-//lpt size = 2^11 x3 bits= 6KB
-//cpt size = 2^13 x2 bits= 16KB
-//total = 60KB < 64KB + 1024B
-
-//tage
-int table_match,alt_match;
+//storage is modeled by TournamentPredictor::storage_model, 61453
+//bits in all
+
+//tage, the geometry of --custom without a named configuration
+int tage_num_tables=6;
+int tage_hist_len=32;
+int tage_base_bits=12;
+int tage_table_hist_len[TAGE_MAX_TABLES]={1,2,4,8,16,32};
+int tage_pred_table_bits=9;
+int tage_tag_bits =13;
+int tage_u_decay=TAGE_U_DECAY;
+int tage_match_kernel=TAGE_MATCH_AVX2;
+int tage_verify_simd=0;
+
+//hashed perceptron
+int perceptron_tables=8;
+int perceptron_table_bits=10;
+int perceptron_hist=256;
+int perceptron_weight_bits=7;
+
+//multiperspective perceptron
+const mpp_feature mpp_features[] = {
+  {MPP_PC, 0, 0, 0},
+  {MPP_GLOBAL, 0, 8, 0},
+  {MPP_GLOBAL, 8, 12, 0},
+  {MPP_GLOBAL, 20, 20, 0},
+  {MPP_GLOBAL, 40, 40, 0},
+  {MPP_GLOBAL, 80, 80, 0},
+  {MPP_GLOBAL, 160, 160, 0},
+  {MPP_PATH, 0, 4, 0},
+  {MPP_PATH, 0, 16, 0},
+  {MPP_LOCAL, 0, 11, 9},
+  {MPP_CALL, 0, 4, 9},
+};
+int mpp_index_bits=10;
+int mpp_weight_bits=6;
+
+//ITTAGE
+int ittage_num_tables=6;
+int ittage_hist_len=48;
+int ittage_base_bits=8;
+int ittage_table_bits=7;
+int ittage_tag_bits=9;
+
+//------------------------------------//
+//      Predictor Data Structures     //
+//------------------------------------//
+
+// Predictor driven through init_predictor/make_prediction/train_predictor
+Predictor *predictor;
 
 //------------------------------------//
 //        Predictor Functions         //
 //------------------------------------//
 
-// Initialize the predictor
-//
+// Scheme names as given on the command line, indexed by type
+static const char *spec_names[NUM_BP_TYPES] = {"static", "gshare",
+                                               "tournament", "custom", "tage-scl",
+                                               "perceptron", "mpp"};
 
-// gshare functions
-void init_gshare()
+// Types whose parameters are those of their TAGE
+static int spec_param_type(int type)
 {
-  int bht_entries = 1 << ghistoryBits;
-  bht_gshare = (uint8_t *)malloc(bht_entries * sizeof(uint8_t));
-  int i = 0;
-  for (i = 0; i < bht_entries; i++)
+  return type == TAGE_SCL ? CUSTOM : type;
+}
+
+void default_spec(predictor_spec *spec, int type)
+{
+  memset(spec, 0, sizeof(*spec));
+  spec->type = type;
+  spec->ghist_bits = ghistoryBits;
+  spec->tnmt_global_bits = tnmt_global_bits;
+  spec->tnmt_local_bits = lhistoryBits;
+  spec->tnmt_lpt_bits = lptbits;
+  spec->tnmt_choice_bits = choicebits;
+  spec->tage.num_tables = tage_num_tables;
+  spec->tage.hist_len = tage_hist_len;
+  spec->tage.base_bits = tage_base_bits;
+  spec->tage.table_bits = tage_pred_table_bits;
+  spec->tage.tag_bits = tage_tag_bits;
+  spec->tage.u_decay = tage_u_decay;
+  memcpy(spec->tage.table_hist_len, tage_table_hist_len, sizeof(spec->tage.table_hist_len));
+  if (type == TAGE_SCL)
   {
-    bht_gshare[i] = WN;
+    spec->tage = tage_runtime_geometry(tage_scl_geometry());
+  }
+  spec->perceptron_tables = perceptron_tables;
+  spec->perceptron_table_bits = perceptron_table_bits;
+  spec->perceptron_hist = perceptron_hist;
+  spec->perceptron_weight_bits = perceptron_weight_bits;
+  spec->mpp_num_features = sizeof(mpp_features) / sizeof(mpp_features[0]);
+  memcpy(spec->mpp_features, mpp_features, sizeof(mpp_features));
+  spec->mpp_index_bits = mpp_index_bits;
+  spec->mpp_weight_bits = mpp_weight_bits;
+  spec->itt.num_tables = ittage_num_tables;
+  spec->itt.hist_len = ittage_hist_len;
+  spec->itt.base_bits = ittage_base_bits;
+  spec->itt.table_bits = ittage_table_bits;
+  spec->itt.tag_bits = ittage_tag_bits;
+}
+
+int spec_type(const char *option)
+{
+  size_t len = strcspn(option, "=:");
+  for (int type = STATIC; type < NUM_BP_TYPES; type++)
+  {
+    if (strlen(spec_names[type]) == len && !strncmp(option, spec_names[type], len))
+    {
+      return type;
+    }
   }
-  ghistory = 0;
+  return -1;
 }
 
-uint8_t gshare_predict(uint32_t pc)
+// Parse a decimal integer spanning [text, text + len)
+//
+// Returns True if Successful
+//
+static int parse_int(const char *text, size_t len, int *value)
 {
-  // get lower ghistoryBits of pc
-  uint32_t bht_entries = 1 << ghistoryBits;
-  uint32_t pc_lower_bits = pc & (bht_entries - 1);
-  uint32_t ghistory_lower_bits = ghistory & (bht_entries - 1);
-  uint32_t index = pc_lower_bits ^ ghistory_lower_bits;
-  switch (bht_gshare[index])
+  char buf[16];
+  char *end;
+  if (len == 0 || len >= sizeof(buf))
   {
-  case WN:
-    return NOTTAKEN;
-  case SN:
-    return NOTTAKEN;
-  case WT:
-    return TAKEN;
-  case ST:
-    return TAKEN;
-  default:
-    printf("Warning: Undefined state of entry in GSHARE BHT!\n");
-    return NOTTAKEN;
+    return 0;
   }
+  memcpy(buf, text, len);
+  buf[len] = '\0';
+  long v = strtol(buf, &end, 10);
+  if (*end != '\0' || v < 0 || v > 100000000)
+  {
+    return 0;
+  }
+  *value = (int)v;
+  return 1;
 }
 
-void train_gshare(uint32_t pc, uint8_t outcome)
+// Parse TAGE history lengths "l0/l1/..." spanning [text, text + len)
+//
+// Returns the number of lengths, or -1 if malformed
+//
+static int parse_lens(const char *text, size_t len, int *lens)
 {
-  // get lower ghistoryBits of pc
-  uint32_t bht_entries = 1 << ghistoryBits;
-  uint32_t pc_lower_bits = pc & (bht_entries - 1);
-  uint32_t ghistory_lower_bits = ghistory & (bht_entries - 1);
-  uint32_t index = pc_lower_bits ^ ghistory_lower_bits;
+  int n = 0;
+  const char *end = text + len;
+  while (text < end)
+  {
+    const char *slash = (const char *)memchr(text, '/', end - text);
+    const char *next = slash != NULL ? slash : end;
+    if (n == TAGE_MAX_TABLES || !parse_int(text, next - text, &lens[n]))
+    {
+      return -1;
+    }
+    n++;
+    text = slash != NULL ? slash + 1 : end;
+  }
+  return n;
+}
 
-  // Update state of entry in bht based on outcome
-  switch (bht_gshare[index])
+// Parse the multiperspective perceptron features "f0/f1/..." spanning
+// [text, text + len), each one of pc, g<start>-<end>, path<n>,
+// local<n> or call<n> with an optional @<index bits>
+//
+// Returns the number of features, or -1 if malformed
+//
+static int parse_features(const char *text, size_t len, mpp_feature *features)
+{
+  struct kind {
+    const char *prefix;
+    int kind;
+  };
+  const kind kinds[] = {
+    {"pc", MPP_PC}, {"g", MPP_GLOBAL}, {"path", MPP_PATH}, {"local", MPP_LOCAL}, {"call", MPP_CALL},
+  };
+
+  int n = 0;
+  const char *end = text + len;
+  while (text < end)
   {
-  case WN:
-    bht_gshare[index] = (outcome == TAKEN) ? WT : SN;
-    break;
-  case SN:
-    bht_gshare[index] = (outcome == TAKEN) ? WN : SN;
-    break;
-  case WT:
-    bht_gshare[index] = (outcome == TAKEN) ? ST : WN;
-    break;
-  case ST:
-    bht_gshare[index] = (outcome == TAKEN) ? ST : WT;
-    break;
-  default:
-    printf("Warning: Undefined state of entry in GSHARE BHT!\n");
-    break;
+    const char *slash = (const char *)memchr(text, '/', end - text);
+    const char *next = slash != NULL ? slash : end;
+    const char *at = (const char *)memchr(text, '@', next - text);
+    const char *arg_end = at != NULL ? at : next;
+    if (n == MPP_MAX_FEATURES)
+    {
+      return -1;
+    }
+    mpp_feature *f = &features[n];
+    memset(f, 0, sizeof(*f));
+    if (at != NULL && !parse_int(at + 1, next - at - 1, &f->index_bits))
+    {
+      return -1;
+    }
+
+    // the longest prefix, as path and pc share one
+    const kind *k = NULL;
+    for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++)
+    {
+      size_t plen = strlen(kinds[i].prefix);
+      if (plen <= (size_t)(arg_end - text) && !strncmp(text, kinds[i].prefix, plen) &&
+          (k == NULL || plen > strlen(k->prefix)))
+      {
+        k = &kinds[i];
+      }
+    }
+    if (k == NULL)
+    {
+      return -1;
+    }
+    f->kind = k->kind;
+    const char *arg = text + strlen(k->prefix);
+    if (f->kind == MPP_GLOBAL)
+    {
+      const char *dash = (const char *)memchr(arg, '-', arg_end - arg);
+      int stop;
+      if (dash == NULL || !parse_int(arg, dash - arg, &f->start) || !parse_int(dash + 1, arg_end - dash - 1, &stop) ||
+          stop <= f->start)
+      {
+        return -1;
+      }
+      f->len = stop - f->start;
+    }
+    else if (f->kind != MPP_PC ? !parse_int(arg, arg_end - arg, &f->len) : arg != arg_end)
+    {
+      return -1;
+    }
+    n++;
+    text = slash != NULL ? slash + 1 : end;
   }
+  return n;
+}
 
-  // Update history register
-  ghistory = ((ghistory << 1) | outcome);
+// Set parameter 'key' of 'spec' from the text spanning [value, value + len)
+//
+// Returns True if Successful
+//
+static int set_spec_param(predictor_spec *spec, const char *key, size_t key_len, const char *value, size_t len)
+{
+  struct param {
+    int type;             // -1 for keys of any type
+    const char *key;
+    int *field;
+  };
+  const param params[] = {
+    {GSHARE, "ghist", &spec->ghist_bits},
+    {TOURNAMENT, "ghist", &spec->tnmt_global_bits},
+    {TOURNAMENT, "lhist", &spec->tnmt_local_bits},
+    {TOURNAMENT, "lpt", &spec->tnmt_lpt_bits},
+    {TOURNAMENT, "choice", &spec->tnmt_choice_bits},
+    {CUSTOM, "tables", &spec->tage.num_tables},
+    {CUSTOM, "hist", &spec->tage.hist_len},
+    {CUSTOM, "base", &spec->tage.base_bits},
+    {CUSTOM, "index", &spec->tage.table_bits},
+    {CUSTOM, "tag", &spec->tage.tag_bits},
+    {CUSTOM, "udecay", &spec->tage.u_decay},
+    {PERCEPTRON, "tables", &spec->perceptron_tables},
+    {PERCEPTRON, "index", &spec->perceptron_table_bits},
+    {PERCEPTRON, "hist", &spec->perceptron_hist},
+    {PERCEPTRON, "weight", &spec->perceptron_weight_bits},
+    {MPP, "index", &spec->mpp_index_bits},
+    {MPP, "weight", &spec->mpp_weight_bits},
+    {-1, "itables", &spec->itt.num_tables},
+    {-1, "ihist", &spec->itt.hist_len},
+    {-1, "ibase", &spec->itt.base_bits},
+    {-1, "iindex", &spec->itt.table_bits},
+    {-1, "itag", &spec->itt.tag_bits},
+  };
+
+  int type = spec_param_type(spec->type);
+  if (key_len == 4 && !strncmp(key, "loop", 4))
+  {
+    if (!parse_int(value, len, &spec->loop) || spec->loop > 1)
+    {
+      fprintf(stderr, "loop takes 0 or 1, not %.*s\n", (int)len, value);
+      return 0;
+    }
+    return 1;
+  }
+  if (key_len == 6 && !strncmp(key, "ittage", 6))
+  {
+    if (!parse_int(value, len, &spec->ittage) || spec->ittage > 1)
+    {
+      fprintf(stderr, "ittage takes 0 or 1, not %.*s\n", (int)len, value);
+      return 0;
+    }
+    return 1;
+  }
+  if (type == CUSTOM && key_len == 4 && !strncmp(key, "lens", 4))
+  {
+    int lens[TAGE_MAX_TABLES];
+    int n = parse_lens(value, len, lens);
+    if (n < 1)
+    {
+      fprintf(stderr, "Malformed TAGE history lengths %.*s\n", (int)len, value);
+      return 0;
+    }
+    memset(spec->tage.table_hist_len, 0, sizeof(spec->tage.table_hist_len));
+    memcpy(spec->tage.table_hist_len, lens, n * sizeof(int));
+    return 1;
+  }
+  if (type == MPP && key_len == 8 && !strncmp(key, "features", 8))
+  {
+    int n = parse_features(value, len, spec->mpp_features);
+    if (n < 1)
+    {
+      fprintf(stderr, "Malformed multiperspective perceptron features %.*s\n", (int)len, value);
+      return 0;
+    }
+    spec->mpp_num_features = n;
+    return 1;
+  }
+
+  for (size_t i = 0; i < sizeof(params) / sizeof(params[0]); i++)
+  {
+    if ((params[i].type == type || params[i].type < 0) && strlen(params[i].key) == key_len && !strncmp(params[i].key, key, key_len))
+    {
+      if (!parse_int(value, len, params[i].field))
+      {
+        fprintf(stderr, "Malformed value %.*s for %s\n", (int)len, value, params[i].key);
+        return 0;
+      }
+      return 1;
+    }
+  }
+  fprintf(stderr, "%s has no parameter %.*s\n", bpName[spec->type], (int)key_len, key);
+  return 0;
 }
 
+int parse_spec(predictor_spec *spec, const char *option)
+{
+  int type = spec_type(option);
+  if (type < 0)
+  {
+    fprintf(stderr, "Unknown predictor %.*s\n", (int)strcspn(option, "=:"), option);
+    return 0;
+  }
+  default_spec(spec, type);
+  const char *p = option + strlen(spec_names[type]);
+  spec->params = *p != '\0' ? p : NULL;
 
-//TAGE Declarations
-void init_tage();
-uint8_t tage_predict(uint32_t pc);
+  // A named TAGE configuration to start from
+  if (*p == '=')
+  {
+    size_t len = strcspn(p + 1, ":");
+    const tage_variant *v = NULL;
+    for (int i = 0; i < num_tage_variants && spec_param_type(type) == CUSTOM; i++)
+    {
+      if (strlen(tage_variants[i].name) == len && !strncmp(tage_variants[i].name, p + 1, len))
+      {
+        v = &tage_variants[i];
+      }
+    }
+    if (v == NULL)
+    {
+      fprintf(stderr, "Unknown %s configuration %.*s\n", bpName[type], (int)len, p + 1);
+      return 0;
+    }
+    spec->tage = v->geometry;
+    p += 1 + len;
+  }
 
-void train_tage(uint32_t pc, uint8_t outcome, int main_pred_table, int alt_pred_table);
+  // Parameters overriding the starting configuration
+  if (*p == ':')
+  {
+    p++;
+    do
+    {
+      size_t len = strcspn(p, ",");
+      const char *eq = (const char *)memchr(p, '=', len);
+      if (eq == NULL)
+      {
+        fprintf(stderr, "Expected <key>=<value>, not %.*s\n", (int)len, p);
+        return 0;
+      }
+      if (!set_spec_param(spec, p, eq - p, eq + 1, p + len - eq - 1))
+      {
+        return 0;
+      }
+      p += len;
+    } while (*p++ == ',');
+  }
 
-void free_tage();
-uint8_t three_pred(uint8_t state);
-uint8_t tage_update_counter(uint8_t counter, uint8_t outcome);
-uint8_t tage_update_useful(uint8_t useful, int increment);
+  return check_spec(spec);
+}
 
+// Check a table index width, printing the problem if out of range
+//
+static int check_bits(const char *scheme, const char *what, int bits, int max)
+{
+  if (bits < 1 || bits > max)
+  {
+    fprintf(stderr, "%s %s needs 1 to %d bits, not %d\n", scheme, what, max, bits);
+    return 0;
+  }
+  return 1;
+}
 
+int check_spec(const predictor_spec *spec)
+{
+  if (spec->loop && spec->type == TAGE_SCL)
+  {
+    fprintf(stderr, "TAGE-SC-L has a loop predictor already\n");
+    return 0;
+  }
+  if (spec->ittage && !ittage_check_geometry(&spec->itt))
+  {
+    return 0;
+  }
+  switch (spec->type)
+  {
+  case STATIC:
+    return 1;
+  case GSHARE:
+    return check_bits("Gshare", "history", spec->ghist_bits, 24);
+  case TOURNAMENT:
+    return check_bits("Tournament", "global history", spec->tnmt_global_bits, 24) &&
+           check_bits("Tournament", "local history table", spec->tnmt_local_bits, 24) &&
+           check_bits("Tournament", "local prediction table", spec->tnmt_lpt_bits, 24) &&
+           check_bits("Tournament", "choice table", spec->tnmt_choice_bits, 24);
+  case CUSTOM:
+  case TAGE_SCL:
+  {
+    int lens = 0;
+    while (lens < TAGE_MAX_TABLES && spec->tage.table_hist_len[lens] != 0)
+    {
+      lens++;
+    }
+    if (lens != spec->tage.num_tables)
+    {
+      fprintf(stderr, "TAGE has %d tables but %d history lengths\n", spec->tage.num_tables, lens);
+      return 0;
+    }
+    return tage_check_geometry(&spec->tage);
+  }
+  case PERCEPTRON:
+    if (spec->perceptron_tables < 1 || spec->perceptron_tables > PERCEPTRON_MAX_TABLES)
+    {
+      fprintf(stderr, "Perceptron needs 1 to %d tables, not %d\n", PERCEPTRON_MAX_TABLES, spec->perceptron_tables);
+      return 0;
+    }
+    if (spec->perceptron_hist < spec->perceptron_tables ||
+        spec->perceptron_hist > PERCEPTRON_MAX_HIST - PERCEPTRON_MAX_TABLES)
+    {
+      fprintf(stderr, "Perceptron history of %d bits is outside the %d to %d supported\n", spec->perceptron_hist,
+              spec->perceptron_tables, PERCEPTRON_MAX_HIST - PERCEPTRON_MAX_TABLES);
+      return 0;
+    }
+    if (spec->perceptron_weight_bits < 2 || spec->perceptron_weight_bits > 8)
+    {
+      fprintf(stderr, "Perceptron weights need 2 to 8 bits, not %d\n", spec->perceptron_weight_bits);
+      return 0;
+    }
+    return check_bits("Perceptron", "table", spec->perceptron_table_bits, 24);
+  case MPP:
+    return mpp_check_features(spec->mpp_features, spec->mpp_num_features, spec->mpp_index_bits,
+                              spec->mpp_weight_bits);
+  default:
+    return 0;
+  }
+}
 
-void cleanup_gshare()
+Predictor *new_predictor(int type)
 {
-  free(bht_gshare);
+  predictor_spec spec;
+  default_spec(&spec, type);
+  return create_predictor(&spec);
 }
 
-void init_predictor()
+Predictor *create_predictor(const predictor_spec *spec)
 {
-  switch (bpType)
+  Predictor *p;
+  switch (spec->type)
   {
   case STATIC:
+    p = new StaticPredictor();
     break;
   case GSHARE:
-    init_gshare();
+    p = new GsharePredictor(spec->ghist_bits);
     break;
   case TOURNAMENT:
-    init_tournament();
+    p = new TournamentPredictor(spec->tnmt_global_bits, spec->tnmt_local_bits, spec->tnmt_lpt_bits,
+                                spec->tnmt_choice_bits);
     break;
   case CUSTOM:
-    init_tage();
+    p = new_tage_predictor(&spec->tage);
     break;
-  default:
+  case TAGE_SCL:
+    p = new_tage_scl_predictor(&spec->tage);
+    break;
+  case PERCEPTRON:
+    p = new PerceptronPredictor(spec->perceptron_tables, spec->perceptron_table_bits, spec->perceptron_hist,
+                                spec->perceptron_weight_bits);
+    break;
+  case MPP:
+    p = new MppPredictor(spec->mpp_features, spec->mpp_num_features, spec->mpp_index_bits, spec->mpp_weight_bits);
     break;
+  default:
+    return NULL;
+  }
+  if (spec->loop)
+  {
+    p = new LoopOverridePredictor(p);
   }
+  return spec->ittage ? new IttageAttachedPredictor(p, &spec->itt) : p;
 }
 
-// Make a prediction for conditional branch instruction at PC 'pc'
-// Returning TAKEN indicates a prediction of taken; returning NOTTAKEN
-// indicates a prediction of not taken
-//
-uint32_t make_prediction(uint32_t pc, uint32_t target, uint32_t direct)
+void storage_add(storage_report *r, int64_t bits, const char *fmt, ...)
 {
+  if (r->count < STORAGE_MAX_ITEMS)
+  {
+    storage_item *item = &r->items[r->count++];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(item->name, sizeof(item->name), fmt, args);
+    va_end(args);
+    item->bits = bits;
+  }
+  r->total += bits;
+}
 
-  // Make a prediction based on the bpType
-  switch (bpType)
+int64_t spec_storage(const predictor_spec *spec, storage_report *r, storage_report *target)
+{
+  memset(r, 0, sizeof(*r));
+  switch (spec->type)
   {
-  case STATIC:
-    return TAKEN;
   case GSHARE:
-    return gshare_predict(pc);
+    GsharePredictor::storage_model(spec->ghist_bits, r);
+    break;
   case TOURNAMENT:
-    return tournament_predict(pc);
+    TournamentPredictor::storage_model(spec->tnmt_global_bits, spec->tnmt_local_bits, spec->tnmt_lpt_bits,
+                                       spec->tnmt_choice_bits, r);
+    break;
   case CUSTOM:
-    return tage_predict(pc);
-  default:
+    tage_storage(&spec->tage, r);
+    break;
+  case TAGE_SCL:
+    tage_scl_storage(&spec->tage, r);
     break;
+  case PERCEPTRON:
+    PerceptronPredictor::storage_model(spec->perceptron_tables, spec->perceptron_table_bits, spec->perceptron_hist,
+                                       spec->perceptron_weight_bits, r);
+    break;
+  case MPP:
+    MppPredictor::storage_model(spec->mpp_features, spec->mpp_num_features, spec->mpp_index_bits,
+                                spec->mpp_weight_bits, r);
+    break;
+  }
+  if (spec->loop)
+  {
+    LoopPredictor::storage(r);
   }
+  if (target != NULL)
+  {
+    memset(target, 0, sizeof(*target));
+    if (spec->ittage)
+    {
+      IttagePredictor::storage(&spec->itt, target);
+    }
+  }
+  return r->total;
+}
 
+// Initialize the predictor
+//
+void init_predictor()
+{
+  delete predictor;
+  predictor = new_predictor(bpType);
+}
+
+// Make a prediction for conditional branch instruction at PC 'pc'
+// Returning TAKEN indicates a prediction of taken; returning NOTTAKEN
+// indicates a prediction of not taken
+//
+uint32_t make_prediction(uint32_t pc, uint32_t target, uint32_t direct)
+{
   // If there is not a compatable bpType then return NOTTAKEN
-  return NOTTAKEN;
+  if (predictor == NULL)
+  {
+    return NOTTAKEN;
+  }
+  return predictor->predict(pc, target, direct);
 }
 
 // Train the predictor the last executed branch at PC 'pc' and with
@@ -209,57 +634,146 @@ uint32_t make_prediction(uint32_t pc, uint32_t target, uint32_t direct)
 
 void train_predictor(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct)
 {
-  if (condition)
+  if (condition && predictor != NULL)
   {
-    switch (bpType)
-    {
-    case STATIC:
-      return;
-    case GSHARE:
-      return train_gshare(pc, outcome);
-    case TOURNAMENT:
-      return train_tournament(pc, outcome, global_pred, local_pred);
-    case CUSTOM:
-      return train_tage(pc,outcome,table_match,alt_match);
-    default:
-      break;
-    }
+    predictor->train(pc, target, outcome, condition, call, ret, direct);
+  }
+  else if (predictor != NULL)
+  {
+    predictor->track(pc, target, call, ret, direct);
   }
 }
 
-void init_tournament()
+// static
+uint8_t StaticPredictor::predict(uint32_t pc, uint32_t target, uint32_t direct)
+{
+  return TAKEN;
+}
+
+void StaticPredictor::train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct)
 {
+}
+
+// gshare functions
+GsharePredictor::GsharePredictor(int history_bits)
+{
+  this->history_bits = history_bits;
+  int bht_entries = 1 << history_bits;
+  bht_gshare = (SatCounter<2> *)malloc(bht_entries * sizeof(SatCounter<2>));
+  int i = 0;
+  for (i = 0; i < bht_entries; i++)
+  {
+    bht_gshare[i].value = WN;
+  }
+  ghistory = 0;
+}
+
+GsharePredictor::~GsharePredictor()
+{
+  free(bht_gshare);
+}
+
+uint32_t GsharePredictor::index(uint32_t pc)
+{
+  // get lower history_bits of pc
+  uint32_t bht_entries = 1 << history_bits;
+  uint32_t pc_lower_bits = pc & (bht_entries - 1);
+  uint32_t ghistory_lower_bits = ghistory & (bht_entries - 1);
+  return pc_lower_bits ^ ghistory_lower_bits;
+}
+
+void GsharePredictor::storage_model(int history_bits, storage_report *r)
+{
+  storage_add(r, (int64_t)2 << history_bits, "pattern table");
+  storage_add(r, history_bits, "global history");
+}
+
+void GsharePredictor::storage(storage_report *r)
+{
+  storage_model(history_bits, r);
+}
+
+uint8_t GsharePredictor::predict(uint32_t pc, uint32_t target, uint32_t direct)
+{
+  return bht_gshare[index(pc)].predict();
+}
+
+void GsharePredictor::train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct)
+{
+  // Update state of entry in bht based on outcome
+  bht_gshare[index(pc)].update(outcome);
+
+  // Update history register
+  ghistory = ((ghistory << 1) | outcome);
+}
+
+//tournament functions
+TournamentPredictor::TournamentPredictor(int global_bits, int local_bits, int lpt_bits, int choice_bits)
+{
+  tnmt_global_bits = global_bits;
+  lhistoryBits = local_bits;
+  lptbits = lpt_bits;
+  choicebits = choice_bits;
+
   uint32_t ghr_entries = 1 << tnmt_global_bits;
   uint32_t lhr_entries = 1 << lhistoryBits;
   uint32_t lpt_entries = 1 << lptbits;
   uint32_t cpt_entries = 1 << choicebits;
 
   lhr_tnmt = (uint64_t *)malloc(lhr_entries * sizeof(uint64_t));
-  ghr_tnmt = (uint8_t *)malloc(ghr_entries * sizeof(uint8_t));
-  lpt_tnmt = (uint8_t *)malloc(lpt_entries * sizeof(uint8_t));
-  cpt_tnmt = (uint8_t *)malloc(cpt_entries * sizeof(uint8_t));
+  ghr_tnmt = (SatCounter<2> *)malloc(ghr_entries * sizeof(SatCounter<2>));
+  lpt_tnmt = (SatCounter<3> *)malloc(lpt_entries * sizeof(SatCounter<3>));
+  cpt_tnmt = (SatCounter<2> *)malloc(cpt_entries * sizeof(SatCounter<2>));
 
   int i;
   for(i=0;i<lpt_entries;i++)
   {
-    lpt_tnmt[i] = TNN;
+    lpt_tnmt[i].value = TNN;
   }
   for(i=0;i<ghr_entries;i++)
   {
-    ghr_tnmt[i] = WN;
+    ghr_tnmt[i].value = WN;
   }
   for(i=0;i<cpt_entries;i++)
   {
-    cpt_tnmt[i] = WN;
+    cpt_tnmt[i].value = WN;
   }
   for(i=0;i<lhr_entries;i++)
   {
     lhr_tnmt[i] = 0;
   } 
   tnmt_ghistory=0;
+  global_pred=WN;
+  local_pred=NTT;
+  choice=WN;
+}
+
+TournamentPredictor::~TournamentPredictor()
+{
+  free(ghr_tnmt);
+  free(lhr_tnmt);
+  free(lpt_tnmt);
+  free(cpt_tnmt);
+}
+
+void TournamentPredictor::storage_model(int global_bits, int local_bits, int lpt_bits, int choice_bits,
+                                        storage_report *r)
+{
+  //local histories are kept to lpt_bits, the width that indexes
+  //the local prediction table
+  storage_add(r, (int64_t)2 << global_bits, "global pattern table");
+  storage_add(r, ((int64_t)1 << local_bits) * lpt_bits, "local history table");
+  storage_add(r, (int64_t)3 << lpt_bits, "local prediction table");
+  storage_add(r, (int64_t)2 << choice_bits, "choice table");
+  storage_add(r, global_bits, "global history");
+}
+
+void TournamentPredictor::storage(storage_report *r)
+{
+  storage_model(tnmt_global_bits, lhistoryBits, lptbits, choicebits, r);
 }
 
-uint8_t tournament_predict(uint32_t pc)
+uint8_t TournamentPredictor::predict(uint32_t pc, uint32_t target, uint32_t direct)
 {
   uint32_t ghr_entries = 1 << tnmt_global_bits;
   uint32_t lhr_entries = 1 << lhistoryBits;
@@ -273,86 +787,21 @@ uint8_t tournament_predict(uint32_t pc)
   uint64_t local_history = lhr_tnmt[pc_index];
   uint64_t lpt_index = local_history & (lpt_entries - 1); //obtain index to address lpt
   
-  switch(lpt_tnmt[lpt_index]){
-    case NNN:
-    local_pred = NOTTAKEN;
-    break;
-  case NNT:
-    local_pred = NOTTAKEN;
-    break;
-  case NTN:
-    local_pred = NOTTAKEN;
-    break;
-  case NTT:
-    local_pred = NOTTAKEN;
-    break;
-  case TNN:
-    local_pred = TAKEN;
-    break;
-  case TNT:
-    local_pred = TAKEN;
-    break;
-  case TTN:
-    local_pred = TAKEN;
-    break;
-  case TTT:
-    local_pred = TAKEN;
-    break;     
-  default:
-    printf("Warning: Undefined state of entry in TNMT LPT!\n");
-    local_pred = NOTTAKEN;
-    break;
-  }
+  local_pred = lpt_tnmt[lpt_index].predict();
+
   uint32_t ghr_index = tnmt_ghistory & (ghr_entries - 1);
-  //uint8_t global_pred,choice;
-  switch (ghr_tnmt[ghr_index])
-  {
-  case WN:
-    global_pred = NOTTAKEN;
-    break;
-  case SN:
-    global_pred = NOTTAKEN;
-    break;
-  case WT:
-    global_pred = TAKEN;
-    break;
-  case ST:
-    global_pred = TAKEN;
-    break;
-  default:
-    printf("Warning: Undefined state of entry in GSHARE BHT!\n");
-    global_pred = NOTTAKEN;
-    break;
-  }
+  global_pred = ghr_tnmt[ghr_index].predict();
 
   uint32_t pc_lower_bits = pc & (cpt_entries - 1);
   uint32_t tnmt_ghistory_lower_bits = tnmt_ghistory & (cpt_entries - 1);
   uint32_t cpt_index = pc_lower_bits ^ tnmt_ghistory_lower_bits;
-  switch (cpt_tnmt[cpt_index])
-  {
-  case WN:
-    choice = NOTTAKEN;
-    break;
-  case SN:
-    choice = NOTTAKEN;
-    break;
-  case WT:
-    choice = TAKEN;
-    break;
-  case ST:
-    choice = TAKEN;
-    break;
-  default:
-    printf("Warning: Undefined state of entry in TNMT CPT!\n");
-    choice = NOTTAKEN;
-    break;
-  }
+  choice = cpt_tnmt[cpt_index].predict();
 
   uint8_t pred = (choice==TAKEN)?local_pred:global_pred;
   return pred;
 }
 
-void train_tournament(uint32_t pc, uint8_t outcome, int global_pred, int local_pred){
+void TournamentPredictor::train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct){
   uint32_t ghr_entries = 1 << tnmt_global_bits;
   uint32_t lhr_entries = 1 << lhistoryBits;
   uint32_t lpt_entries = 1 << lptbits;
@@ -364,163 +813,22 @@ void train_tournament(uint32_t pc, uint8_t outcome, int global_pred, int local_p
   int lpmatch=(local_pred==outcome)?1:0; //does local oredictor match
   int gpmatch=(global_pred==outcome)?1:0; //does global predictor match
 
-  switch (lpt_tnmt[lpt_index])
-  {
-  case NNN:
-    lpt_tnmt[lpt_index] = (outcome == TAKEN) ? NNT : NNN;
-    break;
-  case NNT:
-    lpt_tnmt[lpt_index] = (outcome == TAKEN) ? NTN : NNN;
-    break;
-  case NTN:
-    lpt_tnmt[lpt_index] = (outcome == TAKEN) ? NTT : NNT;
-    break;
-  case NTT:
-    lpt_tnmt[lpt_index] = (outcome == TAKEN) ? TNN : NTN;
-    break;
-  case TNN:
-    lpt_tnmt[lpt_index] = (outcome == TAKEN) ? TNT : NTT;
-    break;
-  case TNT:
-    lpt_tnmt[lpt_index] = (outcome == TAKEN) ? TTN : TNN;
-    break;
-  case TTN:
-    lpt_tnmt[lpt_index] = (outcome == TAKEN) ? TTT : TNT;
-    break;
-  case TTT:
-    lpt_tnmt[lpt_index] = (outcome == TAKEN) ?  TTT : TTN;
-    break;    
-  default:
-    printf("Warning: Undefined state of entry in TNMT LPT!\n");
-    break;
-  }
-
-  switch (ghr_tnmt[ghr_index])
-  {
-  case WN:
-    ghr_tnmt[ghr_index] = (outcome == TAKEN) ? WT : SN;
-    break;
-  case SN:
-    ghr_tnmt[ghr_index] = (outcome == TAKEN) ? WN : SN;
-    break;
-  case WT:
-    ghr_tnmt[ghr_index] = (outcome == TAKEN) ? ST : WN;
-    break;
-  case ST:
-    ghr_tnmt[ghr_index] = (outcome == TAKEN) ? ST : WT;
-    break;
-  default:
-    printf("Warning: Undefined state of entry in TNMT GHR!\n");
-    break;
-  }
+  lpt_tnmt[lpt_index].update(outcome);
+  ghr_tnmt[ghr_index].update(outcome);
 
+  //move the choice towards whichever predictor alone was right,
+  //local counting up
   uint32_t pc_lower_bits = pc & (cpt_entries - 1);
   uint32_t tnmt_ghistory_lower_bits = tnmt_ghistory & (cpt_entries - 1);
   uint32_t cpt_index = pc_lower_bits ^ tnmt_ghistory_lower_bits;
-  cpt_tnmt[cpt_index]=cptupdater(cpt_tnmt[cpt_index],lpmatch,gpmatch);
+  if (lpmatch != gpmatch)
+  {
+    cpt_tnmt[cpt_index].update(lpmatch);
+  }
   tnmt_ghistory = ((tnmt_ghistory << 1) | outcome) & ((1ULL << tnmt_global_bits) - 1);
   lhr_tnmt[lhr_address] = ((lhr_tnmt[lhr_address] << 1) | outcome) & ((1ULL << lptbits) - 1);
 }
 
-//increment counter
-uint8_t inc_ctr(uint8_t state){
-  int newstate;
-  switch(state)
-  {
-    case(SN):
-      newstate=WN;
-      break;
-    case(WN):
-      newstate=WT;
-      break;
-    case(WT):
-      newstate=ST;
-      break;
-    case(ST):
-      newstate=ST;  
-      break;
-    default:
-      newstate=state;
-      printf("Warning: Invalid counter state!");
-      break;  
-  }
-  return newstate;
-}
-
-uint8_t dec_ctr(uint8_t state){
-  uint8_t newstate;
-  switch(state)
-  {
-    case(SN):
-      newstate=SN;
-      break;
-    case(WN):
-      newstate=SN;
-      break;
-    case(WT):
-      newstate=WN;
-      break;
-    case(ST):
-      newstate=WT;  
-      break;
-    default:
-      newstate=state;
-      printf("Warning: Invalid counter state!");
-      break;  
-  }
-  return newstate;
-}
-
-uint8_t cptupdater(uint8_t state, int lpred, int gpred)
-{
-  uint8_t ctr=state;
-  if((gpred==1)&&(lpred==0))
-    return dec_ctr(ctr);
-  else if(((gpred==0)&&(lpred==1)))
-    return inc_ctr(ctr);
-  else
-    return ctr;
-}
-
-void free_tournament(){
-  free(ghr_tnmt);
-  free(lhr_tnmt);
-  free(lpt_tnmt);
-  free(cpt_tnmt);
-}
-
-//TAGE Data Structures
-int tage_hist_len=32;
-int tage_base_bits=12;
-int tage_table_hist_len[TAGE_NUM_TABLE]={1,2,4,8,16,32};
-int tage_pred_table_bits=9;
-int tage_tag_bits =13;
-//int global_index_bits=10;
-
-struct tage_table_entry{
-  uint32_t tag;
-  uint8_t ctr;
-  uint8_t u;
-};
-
-uint64_t tage_ghistory;
-
-uint8_t *tage_base_pred_table;
-tage_table_entry **tage_tables;
-
-//int table_match,alt_match;
-
-int tage_counter;
-uint8_t two_pred(uint8_t state);
-uint8_t two_bit_update(uint8_t state, uint8_t outcome);
-
-//custom predictor functions
-uint8_t three_pred(uint8_t state);
-uint8_t tage_update_counter(uint8_t counter, uint8_t outcome);
-uint8_t inc_3ctr(uint8_t ctr);
-uint8_t dec_3ctr(uint8_t ctr);
-
-
 //hashing function to condense history into fewer bits(target_len)
 uint32_t hash(uint64_t history, int len, int target_len){
   uint64_t folded = 0;
@@ -531,362 +839,3 @@ uint32_t hash(uint64_t history, int len, int target_len){
   }
   return folded & mask;
 }
-
-uint32_t tage_index(uint32_t pc, uint64_t history, int len, int table_num){
-  uint32_t index_bits = tage_pred_table_bits;
-  uint32_t mask = (1 << index_bits) - 1;
-  //PC^hashed history
-  uint32_t pc_index = ((pc>>2)^table_num)&mask; //ignore L2SBs
-  uint32_t hist_index = hash(history, len, index_bits);
-  return (pc_index^hist_index)&mask;
-}
-
-uint32_t tage_tag(uint32_t pc, uint64_t history, int len,int table_num)
-{
-  uint32_t mask = (1<<tage_tag_bits)-1;
-  
-  uint32_t pc_tag = ((pc >> (2 + tage_pred_table_bits))^table_num) & mask;
-  uint32_t hist_tag = hash(history, len, tage_tag_bits);
-    
-  return ((pc_tag ^ hist_tag) & mask);
-}
-
-void init_tage()
-{
-  //init base predictor
-  uint32_t base_entries = 1<<tage_base_bits;
-  tage_base_pred_table=(uint8_t *)malloc(base_entries*sizeof(uint8_t));
-
-  int i;
-  for (i=0;i<base_entries;i++){
-    tage_base_pred_table[i]=WN; //init to weakly not taken
-  }
-
-  //tage_table_entry **tage_tables;
-
-  //init tage tables
-  tage_tables = (tage_table_entry **)malloc(TAGE_NUM_TABLE * sizeof(tage_table_entry *));
-  uint32_t table_entries = 1<<tage_pred_table_bits;
-  int j;
-  for(i=0;i<TAGE_NUM_TABLE;i++){
-    tage_tables[i] = (tage_table_entry *)malloc(table_entries * sizeof(tage_table_entry));
-    for(j=0;j<table_entries;j++){
-      tage_tables[i][j].ctr=TNN; //init counters to 011
-      tage_tables[i][j].tag=0;  //init tag to 0
-      tage_tables[i][j].u=0;    //init useful bit to 0
-    }
-  }
-  tage_ghistory=0;
-  tage_counter=0;
-
-}
-
-
-uint8_t tage_predict(uint32_t pc){
-  uint32_t base_index = ((pc>>2) & ((1<<tage_base_bits)-1));
-  uint8_t base_pred;
-  switch(tage_base_pred_table[base_index]){
-    case WN:
-      base_pred=NOTTAKEN;
-      break;
-    case SN:
-      base_pred=NOTTAKEN;
-      break;
-    case WT:
-      base_pred=TAKEN;
-      break;
-    case ST:
-      base_pred=TAKEN;
-      break;
-    default:
-      printf("Invalid state of entry in TAGE Base Predictor table");
-      break;
-  }
-
-  table_match=-1;
-  alt_match=-1;
-  int i;
-  for(i=TAGE_NUM_TABLE-1;i>=0;i--)
-  {
-    uint32_t table_index=tage_index(pc,tage_ghistory,tage_table_hist_len[i],i);
-    uint8_t pc_tag=tage_tag(pc,tage_ghistory,tage_table_hist_len[i],i);
-
-    if(tage_tables[i][table_index].tag==pc_tag){
-      if(table_match==-1)
-        table_match=i;
-      else if(alt_match==-1)
-        alt_match=i;
-    }
-  }
-
-  if(table_match>=0){
-    uint32_t temp_index=tage_index(pc,tage_ghistory,tage_table_hist_len[table_match],table_match);
-    uint8_t temp_var=three_pred(tage_tables[table_match][temp_index].ctr);
-    return temp_var;
-  }
-  else{
-    return base_pred;
-  }
-}
-
-void train_tage(uint32_t pc, uint8_t outcome, int main_pred_table, int alt_pred_table){
-
-
-  uint32_t base_index= (pc>>2)&((1<<tage_base_bits)-1);
-  uint8_t base_pred=two_pred(tage_base_pred_table[base_index]);
-  uint32_t main_index = 0;
-  uint32_t alt_index = 0;
-  uint8_t main_pred;
-  uint8_t alt_pred;
-  if(main_pred_table >= 0){
-    main_index = tage_index(pc, tage_ghistory, tage_table_hist_len[main_pred_table],main_pred_table);
-    main_pred = three_pred(tage_tables[main_pred_table][main_index].ctr);
-  } else {
-    main_pred = base_pred;
-  }
-  
-  if(alt_pred_table >= 0){
-    alt_index = tage_index(pc, tage_ghistory, tage_table_hist_len[alt_pred_table],alt_pred_table);
-    alt_pred = three_pred(tage_tables[alt_pred_table][alt_index].ctr);
-  } else {
-    alt_pred = base_pred;
-  }
-
-  //Tage counter update
-  if(main_pred_table>=0){
-    tage_tables[main_pred_table][main_index].ctr=(outcome==TAKEN)?inc_3ctr(tage_tables[main_pred_table][main_index].ctr):dec_3ctr(tage_tables[main_pred_table][main_index].ctr);
-  }
-  else{
-    tage_base_pred_table[base_index]=two_bit_update(tage_base_pred_table[base_index],outcome);
-  }
-
-  //useful bits update
-  if(main_pred_table>=0){
-    if((main_pred == outcome) && (alt_pred!=outcome)){
-      tage_tables[main_pred_table][main_index].u = tage_update_useful(tage_tables[main_pred_table][main_index].u,1);
-    }
-    else if((main_pred != outcome) && (alt_pred==outcome)){
-      tage_tables[main_pred_table][main_index].u = tage_update_useful(tage_tables[main_pred_table][main_index].u,0);
-    }
-  }
-
-  //allocate in new table if no main_pred found
-  if(main_pred != outcome)
-  {
-    int allocate_table=-1;
-
-    for(int i=TAGE_NUM_TABLE-1;i>=0;i--)
-    {
-      if(main_pred_table==-1 || i>main_pred_table){
-        uint32_t temp_index = tage_index(pc, tage_ghistory, tage_table_hist_len[i],i);
-        
-        if(tage_tables[i][temp_index].u==0){
-          allocate_table=i;
-          break;
-        }
-      }
-    }
-
-    if(allocate_table>=0){
-      uint32_t allocate_index = tage_index(pc,tage_ghistory,tage_table_hist_len[allocate_table],allocate_table);
-      uint8_t allocate_tag=tage_tag(pc,tage_ghistory,tage_table_hist_len[allocate_table],allocate_table);
-
-      tage_tables[allocate_table][allocate_index].tag=allocate_tag;
-      tage_tables[allocate_table][allocate_index].ctr=(outcome==TAKEN)? TNN:NTT;
-      tage_tables[allocate_table][allocate_index].u=0;
-    }
-    else {
-      //decrease usefulness of the entry with mismatched tag
-      for (int i = main_pred_table + 1; i < TAGE_NUM_TABLE; i++) {
-         uint32_t temp_index = tage_index(pc, tage_ghistory, tage_table_hist_len[i], i);
-         // Use your existing function to safely decrement
-         tage_tables[i][temp_index].u = tage_update_useful(tage_tables[i][temp_index].u, 0); 
-      }
-    }
-    
-  }
-  tage_counter++;
-
-  //reset to prevent stale entires
-  if(tage_counter==256000){
-    for(int i=0;i<TAGE_NUM_TABLE;i++){
-      uint32_t table_entries = 1<<tage_pred_table_bits;
-      for(int j=0;j<table_entries;j++){
-        tage_tables[i][j].u=tage_tables[i][j].u >> 1; //right shift by one
-      }
-    }
-    tage_counter=0;
-  }
-
-  tage_ghistory = (tage_ghistory<<1)|outcome;
-  tage_ghistory &= ((1ULL << tage_hist_len) - 1);;
-}
-
-void free_tage(){
-  free(tage_base_pred_table);
-  for(int i=0;i<TAGE_NUM_TABLE;i++){
-    free(tage_tables[i]);
-  }
-  free(tage_tables);
-}
-
-
-uint8_t three_pred(uint8_t state)
-{
-  switch(state){
-    case NNN:
-      return NOTTAKEN;
-      break;
-    case NNT:
-      return NOTTAKEN;
-      break;
-    case NTN:
-      return NOTTAKEN;
-      break;
-    case NTT:
-      return NOTTAKEN;
-      break;
-    case TNN:
-      return TAKEN;
-      break; 
-    case TNT:
-      return TAKEN;
-      break;  
-    case TTN:
-      return TAKEN;
-      break;
-    case TTT:
-      return TAKEN;
-      break;
-    default:
-      printf("Invalid counter state");
-      return NOTTAKEN;
-      break;             
-  }
-}
-
-uint8_t tage_update_counter(uint8_t counter, uint8_t outcome) {
-    if (outcome == TAKEN) {
-        return (counter < 7) ? counter + 1 : 7; 
-    } else {
-        return (counter > 0) ? counter - 1 : 0; 
-    }
-}
-
-uint8_t tage_update_useful(uint8_t useful, int increment) {
-    if (increment) {
-        return (useful < 3) ? useful + 1 : 3;
-    } else {
-        return (useful > 0) ? useful - 1 : 0;
-    }
-}
-
-uint8_t two_pred(uint8_t state){
-  uint8_t pred;
-  switch(state)
-  {
-    case SN:
-       pred = NOTTAKEN;
-      break;
-    case WN:
-      pred= NOTTAKEN;
-      break;
-    case WT:
-      pred= TAKEN;
-      break;
-    case ST:
-      pred= TAKEN;  
-      break;
-    default:
-      pred = NOTTAKEN;
-      printf("Warning: Invalid counter state!");
-      break;  
-  }
-  return pred;
-}
-
-uint8_t two_bit_update(uint8_t state, uint8_t outcome) {
-  if (outcome == TAKEN) {
-    switch(state) {
-      case SN: return WN;
-      case WN: return WT;
-      case WT: return ST;
-      case ST: return ST;
-      default: return state;
-    }
-  } else {
-    switch(state) {
-      case SN: return SN;
-      case WN: return SN;
-      case WT: return WN;
-      case ST: return WT;
-      default: return state;
-    }
-  }
-}
-
-uint8_t inc_3ctr(uint8_t ctr){
-  switch(ctr){
-    case NNN:
-      return NNT;
-      break;
-    case NNT:
-      return NTN;
-      break;
-    case NTN:
-      return NTT;
-      break;
-    case NTT:
-      return TNN;
-      break;
-    case TNN:
-      return TNT;
-      break; 
-    case TNT:
-      return TTN;
-      break;  
-    case TTN:
-      return TTT;
-      break;
-    case TTT:
-      return TTT;
-      break;
-    default:
-      printf("Invalid counter state");
-      return ctr;
-      break;             
-  }
-}
-
-uint8_t dec_3ctr(uint8_t ctr){
-  switch(ctr){
-    case NNN:
-      return NNN;
-      break;
-    case NNT:
-      return NNN;
-      break;
-    case NTN:
-      return NNT;
-      break;
-    case NTT:
-      return NTN;
-      break;
-    case TNN:
-      return NTT;
-      break; 
-    case TNT:
-      return TNN;
-      break;  
-    case TTN:
-      return TNT;
-      break;
-    case TTT:
-      return TTN;
-      break;
-    default:
-      printf("Invalid counter state");
-      return ctr;
-      break;             
-  }
-}
\ No newline at end of file
@@ -70,20 +70,14 @@ void train_predictor(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t co
 // Please add your code below, and DO NOT MODIFY ANY OF THE CODE ABOVE
 // 
 
-void init_tournament();
-//initialize data structures for tournament predictor
+#include "history.h"
+#include "counter.h"
 
-uint8_t tournament_predict(uint32_t pc);
-
-void train_tournament(uint32_t pc, uint8_t outcome, int global_pred, int local_pred);
-
-uint8_t inc_ctr(uint8_t state);
-
-uint8_t dec_ctr(uint8_t state);
-
-uint8_t cptupdater(uint8_t state, int lpred, int gpred);
-
-void free_tournament();
+// Predictor types past those above
+#define TAGE_SCL 4
+#define PERCEPTRON 5
+#define MPP 6
+#define NUM_BP_TYPES 7
 
 //3 bit counter definitions
 #define NNN 0 //strong not taken
@@ -95,23 +89,234 @@ void free_tournament();
 #define TTN 6
 #define TTT 7 //strong taken
 
-//TAGE definitions
-#define TAGE_NUM_TABLE 6
-
+//hashing function to condense history into fewer bits(target_len)
 uint32_t hash(uint64_t history, int len, int target_len);
-uint32_t tage_index(uint32_t pc, uint64_t history, int len);
-uint32_t tage_tag(uint32_t pc, uint64_t history, int len);
 
-void init_tage();
-uint8_t tage_predict(uint32_t pc);
+//------------------------------------//
+//          Storage Budget            //
+//------------------------------------//
+
+#define STORAGE_BUDGET_BITS (64 * 1024) // the 64Kbit budget
+#define STORAGE_MAX_ITEMS 32
+
+// Modeled hardware storage of a predictor, structure by structure
+struct storage_item {
+  char name[40];
+  int64_t bits;
+};
+
+struct storage_report {
+  int count;
+  int64_t total;
+  storage_item items[STORAGE_MAX_ITEMS];
+};
+
+// Add a structure of 'bits' bits, named by the printf format 'fmt',
+// to 'r'
+//
+void storage_add(storage_report *r, int64_t bits, const char *fmt, ...);
+
+// Bits of a counter that wraps after 'n' counts
+//
+constexpr int storage_count_bits(int64_t n)
+{
+  return n <= 1 ? 0 : 1 + storage_count_bits((n + 1) / 2);
+}
+
+//------------------------------------//
+//        Predictor Instances         //
+//------------------------------------//
+
+// A predictor keeps all of its tables, histories and the context
+// handed from predict() to train() in its instance, so any number
+// of them can run side by side, one per thread or many per thread
+//
+class Predictor
+{
+public:
+  virtual ~Predictor() {}
+
+  // Make a prediction for conditional branch instruction at PC 'pc'
+  virtual uint8_t predict(uint32_t pc, uint32_t target, uint32_t direct) = 0;
+
+  // Train on the branch at PC 'pc' that was just predicted
+  virtual void train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct) = 0;
+
+  // Follow a branch that is not conditional, for predictors whose
+  // histories take in calls, returns and jumps
+  virtual void track(uint32_t pc, uint32_t target, uint32_t call, uint32_t ret, uint32_t direct) {}
+
+  // Add the modeled storage of every direction prediction structure
+  // to 'r'
+  virtual void storage(storage_report *r) = 0;
+
+  // Write any statistics beyond mispredictions to 'buf' as lines
+  // of report, or an empty string if there are none
+  virtual void format_stats(char *buf, size_t size) { buf[0] = '\0'; }
+};
+
+// Create a predictor of type 'type' (STATIC, GSHARE, ...) with
+// its default configuration, or NULL for an unknown type
+//
+Predictor *new_predictor(int type);
+
+#define TAGE_MAX_TABLES 8 // one per 32-bit lane of the AVX2 tag match
+
+// Geometry of a TAGE predictor
+struct tage_geometry {
+  int num_tables;     // tagged tables
+  int hist_len;       // global history bits
+  int base_bits;      // log2 entries of the base predictor
+  int table_bits;     // log2 entries of each tagged table
+  int tag_bits;       // tag hash width, TAGE keeps the low 8 bits
+  int u_decay;        // trains between halvings of the useful bits
+  int table_hist_len[TAGE_MAX_TABLES];
+};
+
+#define MPP_MAX_FEATURES 16
+
+// Inputs of the multiperspective perceptron
+#define MPP_PC 0      // branch pc alone
+#define MPP_GLOBAL 1  // global history bits [start, start + len)
+#define MPP_PATH 2    // targets of the last len taken branches
+#define MPP_LOCAL 3   // len bits of the branch's own history
+#define MPP_CALL 4    // the len innermost call sites
+
+// One input of the multiperspective perceptron and its table
+struct mpp_feature {
+  int kind;
+  int start;
+  int len;
+  int index_bits;  // log2 weights of its table, 0 for the spec's default
+};
+
+#define ITTAGE_MAX_TABLES 8
+
+// Geometry of an ITTAGE target predictor
+struct ittage_geometry {
+  int num_tables;     // tagged tables
+  int hist_len;       // longest global history, of the last table
+  int base_bits;      // log2 entries of the base table
+  int table_bits;     // log2 entries of each tagged table
+  int tag_bits;       // tag width
+};
+
+// A predictor configuration to simulate: a scheme and the sizes of
+// its structures, which start from the global defaults
+struct predictor_spec {
+  int type;
+  const char *params;    // text after the scheme name it was parsed from, or NULL
+  int ghist_bits;        // GSHARE
+  int tnmt_global_bits;  // TOURNAMENT
+  int tnmt_local_bits;
+  int tnmt_lpt_bits;
+  int tnmt_choice_bits;
+  tage_geometry tage;    // CUSTOM and TAGE_SCL
+  int perceptron_tables; // PERCEPTRON
+  int perceptron_table_bits;
+  int perceptron_hist;
+  int perceptron_weight_bits;
+  mpp_feature mpp_features[MPP_MAX_FEATURES]; // MPP
+  int mpp_num_features;
+  int mpp_index_bits;
+  int mpp_weight_bits;
+  int loop;              // overridden by a loop predictor, any but TAGE_SCL
+  int ittage;            // indirect targets predicted by an ITTAGE, any type
+  ittage_geometry itt;
+};
+
+// Returns the type of the scheme 'option' names, before any '=' or
+// ':', or -1 if it names none
+//
+int spec_type(const char *option);
+
+// Parse a scheme option without its leading "--":
+//   <scheme>[=<variant>][:<key>=<value>,...]
+// where a variant names a registered TAGE configuration to start
+// from, the key loop=1 puts a loop predictor in front of any
+// scheme and ittage=1 adds a target predictor for its indirect
+// branches. 'option' must outlive 'spec'
+//
+// Returns True if Successful, printing the problem otherwise
+//
+int parse_spec(predictor_spec *spec, const char *option);
+
+// Fill 'spec' with the default configuration of 'type'
+//
+void default_spec(predictor_spec *spec, int type);
+
+// Returns True if the sizes in 'spec' can be simulated, printing
+// the problem otherwise
+//
+int check_spec(const predictor_spec *spec);
+
+// Create the predictor 'spec' describes, or NULL for an unknown type
+//
+Predictor *create_predictor(const predictor_spec *spec);
+
+// Fill 'r' with the modeled storage of the direction predictor
+// 'spec' describes, without creating it. An attached ITTAGE is a
+// target predictor outside the direction budget, so it goes to
+// 'target' instead, when not NULL
+//
+// Returns the total in bits of 'r'
+//
+int64_t spec_storage(const predictor_spec *spec, storage_report *r, storage_report *target);
+
+class StaticPredictor : public Predictor
+{
+public:
+  uint8_t predict(uint32_t pc, uint32_t target, uint32_t direct);
+  void train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct);
+  void storage(storage_report *r) {}
+};
+
+class GsharePredictor : public Predictor
+{
+public:
+  GsharePredictor(int history_bits);
+  ~GsharePredictor();
+  uint8_t predict(uint32_t pc, uint32_t target, uint32_t direct);
+  void train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct);
+  void storage(storage_report *r);
+
+  static void storage_model(int history_bits, storage_report *r);
+
+private:
+  uint32_t index(uint32_t pc);
+
+  int history_bits;
+  SatCounter<2> *bht_gshare;
+  uint64_t ghistory;
+};
+
+class TournamentPredictor : public Predictor
+{
+public:
+  TournamentPredictor(int global_bits, int local_bits, int lpt_bits, int choice_bits);
+  ~TournamentPredictor();
+  uint8_t predict(uint32_t pc, uint32_t target, uint32_t direct);
+  void train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct);
+  void storage(storage_report *r);
+
+  static void storage_model(int global_bits, int local_bits, int lpt_bits, int choice_bits, storage_report *r);
 
-void train_tage(uint32_t pc, uint8_t outcome, int main_pred_table, int alt_pred_table);
+private:
+  int tnmt_global_bits;
+  int lhistoryBits;
+  int lptbits;
+  int choicebits;
 
-void free_tage();
-uint8_t three_pred(uint8_t state);
-uint8_t tage_update_counter(uint8_t counter, uint8_t outcome);
-uint8_t tage_update_useful(uint8_t useful, int increment);
+  uint64_t tnmt_ghistory;
+  uint64_t *lhr_tnmt;
+  SatCounter<3> *lpt_tnmt;
+  SatCounter<2> *ghr_tnmt;
+  SatCounter<2> *cpt_tnmt;
 
-uint8_t two_pred(uint8_t state);
+  // component predictions of the last predict(), used by train()
+  uint8_t global_pred;
+  uint8_t local_pred;
+  uint8_t choice;
+};
 
 #endif
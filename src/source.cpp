@@ -0,0 +1,320 @@
+//========================================================//
+//  source.cpp                                            //
+//  Source file for the trace byte sources                //
+//                                                        //
+//  The bzip2 source runs libbz2 on its own thread so     //
+//  decompression overlaps with prediction instead of     //
+//  going through a bunzip2 pipe                          //
+//========================================================//
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <bzlib.h>
+#include "source.h"
+
+// Size of the compressed input buffer of the decompressor
+#define BZIP2_INPUT_SIZE (1 << 20)
+
+int source_is_bzip2(const unsigned char *magic, size_t len)
+{
+  return len >= 4 && magic[0] == 'B' && magic[1] == 'Z' && magic[2] == 'h' &&
+         magic[3] >= '1' && magic[3] <= '9';
+}
+
+//------------------------------------//
+//            File Source             //
+//------------------------------------//
+
+struct file_source {
+  chunk_source base;
+  FILE *stream;
+  char *data;
+  unsigned char ahead[SOURCE_HEAD_MAX];  // read from 'stream' before it was handed over
+  size_t ahead_len;
+};
+
+static size_t file_source_read(chunk_source *src, char *buf, size_t cap)
+{
+  file_source *f = (file_source *)src;
+  size_t n = f->ahead_len < cap ? f->ahead_len : cap;
+  memcpy(buf, f->ahead, n);
+  memmove(f->ahead, f->ahead + n, f->ahead_len - n);
+  f->ahead_len -= n;
+  n += fread(buf + n, 1, cap - n, f->stream);
+  if (n == 0)
+  {
+    src->error = ferror(f->stream) ? 1 : 0;
+  }
+  return n;
+}
+
+static int file_source_next(chunk_source *src, char **data, size_t *len)
+{
+  file_source *f = (file_source *)src;
+  size_t n = file_source_read(src, f->data, SOURCE_CHUNK_SIZE);
+  if (n == 0)
+  {
+    return 0;
+  }
+  f->data[n] = '\0';
+  *data = f->data;
+  *len = n;
+  return 1;
+}
+
+static void file_source_close(chunk_source *src)
+{
+  file_source *f = (file_source *)src;
+  fclose(f->stream);
+  free(f->data);
+  free(f);
+}
+
+chunk_source *file_source_open(FILE *stream, const unsigned char *head, size_t head_len)
+{
+  file_source *f = (file_source *)calloc(1, sizeof(file_source));
+  f->base.next = file_source_next;
+  f->base.close = file_source_close;
+  f->base.read = file_source_read;
+  f->stream = stream;
+  f->data = (char *)malloc(SOURCE_CHUNK_SIZE + 1);
+  memcpy(f->ahead, head, head_len);
+  f->ahead_len = head_len;
+  return &f->base;
+}
+
+//------------------------------------//
+//           bzip2 Source             //
+//------------------------------------//
+
+struct bzip2_source {
+  chunk_source base;
+  int fd;
+  unsigned char ahead[SOURCE_HEAD_MAX];  // read from 'fd' before it was handed over
+  size_t ahead_len;
+  pthread_t thread;
+
+  // Ring of chunks, filled by the decompressor thread in
+  // order and drained by the parser. 'count' includes the
+  // chunk the parser currently holds
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  char *data[SOURCE_RING_SLOTS];
+  size_t len[SOURCE_RING_SLOTS];
+  int head;
+  int tail;
+  int count;
+  int held;
+  int done;
+  int stop;
+};
+
+// Hand a filled chunk to the parser, waiting for a free slot.
+//
+// Returns False if the source is being closed
+//
+static int bzip2_publish(bzip2_source *b, size_t len)
+{
+  pthread_mutex_lock(&b->lock);
+  b->data[b->head][len] = '\0';
+  b->len[b->head] = len;
+  b->head = (b->head + 1) % SOURCE_RING_SLOTS;
+  b->count++;
+  pthread_cond_broadcast(&b->cond);
+  while (b->count == SOURCE_RING_SLOTS && !b->stop)
+  {
+    pthread_cond_wait(&b->cond, &b->lock);
+  }
+  int stop = b->stop;
+  pthread_mutex_unlock(&b->lock);
+  return !stop;
+}
+
+static void bzip2_finish(bzip2_source *b, int error)
+{
+  pthread_mutex_lock(&b->lock);
+  b->base.error = error;
+  b->done = 1;
+  pthread_cond_broadcast(&b->cond);
+  pthread_mutex_unlock(&b->lock);
+}
+
+// Decompressor thread. Handles concatenated streams and
+// ignores trailing garbage the way bunzip2 does
+//
+static void *bzip2_thread(void *arg)
+{
+  bzip2_source *b = (bzip2_source *)arg;
+  char *in = (char *)malloc(BZIP2_INPUT_SIZE);
+  bz_stream strm;
+  memset(&strm, 0, sizeof(strm));
+  if (BZ2_bzDecompressInit(&strm, 0, 0) != BZ_OK)
+  {
+    free(in);
+    bzip2_finish(b, 1);
+    return NULL;
+  }
+
+  int error = 0;
+  int eof = 0;
+  int streams = 0;
+  size_t filled = 0;
+  memcpy(in, b->ahead, b->ahead_len);
+  strm.next_in = in;
+  strm.avail_in = b->ahead_len;
+  strm.next_out = b->data[b->head];
+  strm.avail_out = SOURCE_CHUNK_SIZE;
+  for (;;)
+  {
+    if (strm.avail_in == 0 && !eof)
+    {
+      ssize_t n = read(b->fd, in, BZIP2_INPUT_SIZE);
+      if (n < 0)
+      {
+        error = 1;
+        break;
+      }
+      eof = n == 0;
+      strm.next_in = in;
+      strm.avail_in = n;
+    }
+
+    // The input may only run out between two streams
+    int fresh = strm.total_in_lo32 == 0 && strm.total_in_hi32 == 0;
+    if (strm.avail_in == 0 && eof && fresh)
+    {
+      error = streams == 0;
+      break;
+    }
+
+    int ret = BZ2_bzDecompress(&strm);
+    filled = SOURCE_CHUNK_SIZE - strm.avail_out;
+    if (ret == BZ_STREAM_END)
+    {
+      // Another stream may follow the one that just ended
+      streams++;
+      char *next_in = strm.next_in;
+      unsigned int avail_in = strm.avail_in;
+      char *next_out = strm.next_out;
+      unsigned int avail_out = strm.avail_out;
+      BZ2_bzDecompressEnd(&strm);
+      memset(&strm, 0, sizeof(strm));
+      if (BZ2_bzDecompressInit(&strm, 0, 0) != BZ_OK)
+      {
+        error = 1;
+        break;
+      }
+      strm.next_in = next_in;
+      strm.avail_in = avail_in;
+      strm.next_out = next_out;
+      strm.avail_out = avail_out;
+    }
+    else if (ret == BZ_DATA_ERROR_MAGIC && streams > 0)
+    {
+      break;
+    }
+    else if (ret != BZ_OK || (eof && strm.avail_in == 0 && strm.avail_out > 0))
+    {
+      // Corrupt data, or the file ends inside a stream
+      error = 1;
+      break;
+    }
+
+    if (strm.avail_out == 0)
+    {
+      if (!bzip2_publish(b, filled))
+      {
+        BZ2_bzDecompressEnd(&strm);
+        free(in);
+        return NULL;
+      }
+      filled = 0;
+      strm.next_out = b->data[b->head];
+      strm.avail_out = SOURCE_CHUNK_SIZE;
+    }
+  }
+  BZ2_bzDecompressEnd(&strm);
+  free(in);
+
+  if (!error && filled > 0)
+  {
+    bzip2_publish(b, filled);
+  }
+  bzip2_finish(b, error);
+  return NULL;
+}
+
+static int bzip2_source_next(chunk_source *src, char **data, size_t *len)
+{
+  bzip2_source *b = (bzip2_source *)src;
+  pthread_mutex_lock(&b->lock);
+  if (b->held)
+  {
+    b->tail = (b->tail + 1) % SOURCE_RING_SLOTS;
+    b->count--;
+    b->held = 0;
+    pthread_cond_broadcast(&b->cond);
+  }
+  while (b->count == 0 && !b->done)
+  {
+    pthread_cond_wait(&b->cond, &b->lock);
+  }
+  int ok = b->count > 0;
+  if (ok)
+  {
+    *data = b->data[b->tail];
+    *len = b->len[b->tail];
+    b->held = 1;
+  }
+  pthread_mutex_unlock(&b->lock);
+  return ok;
+}
+
+static void bzip2_source_close(chunk_source *src)
+{
+  bzip2_source *b = (bzip2_source *)src;
+  pthread_mutex_lock(&b->lock);
+  b->stop = 1;
+  pthread_cond_broadcast(&b->cond);
+  pthread_mutex_unlock(&b->lock);
+  pthread_join(b->thread, NULL);
+
+  pthread_mutex_destroy(&b->lock);
+  pthread_cond_destroy(&b->cond);
+  for (int i = 0; i < SOURCE_RING_SLOTS; i++)
+  {
+    free(b->data[i]);
+  }
+  close(b->fd);
+  free(b);
+}
+
+chunk_source *bzip2_source_open(int fd, const unsigned char *head, size_t head_len)
+{
+  bzip2_source *b = (bzip2_source *)calloc(1, sizeof(bzip2_source));
+  b->base.next = bzip2_source_next;
+  b->base.close = bzip2_source_close;
+  b->fd = fd;
+  memcpy(b->ahead, head, head_len);
+  b->ahead_len = head_len;
+  for (int i = 0; i < SOURCE_RING_SLOTS; i++)
+  {
+    b->data[i] = (char *)malloc(SOURCE_CHUNK_SIZE + 1);
+  }
+  pthread_mutex_init(&b->lock, NULL);
+  pthread_cond_init(&b->cond, NULL);
+
+  if (pthread_create(&b->thread, NULL, bzip2_thread, b) != 0)
+  {
+    pthread_mutex_destroy(&b->lock);
+    pthread_cond_destroy(&b->cond);
+    for (int i = 0; i < SOURCE_RING_SLOTS; i++)
+    {
+      free(b->data[i]);
+    }
+    free(b);
+    return NULL;
+  }
+  return &b->base;
+}
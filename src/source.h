@@ -0,0 +1,65 @@
+//========================================================//
+//  source.h                                              //
+//  Header file for the trace byte sources                //
+//                                                        //
+//  Text traces reach the parser as a sequence of large   //
+//  chunks, read straight from a file or decompressed     //
+//  from bzip2 on worker threads                          //
+//========================================================//
+
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Size of each chunk handed to the parser
+#define SOURCE_CHUNK_SIZE (4 << 20)
+
+// Number of chunks in flight between decompressor and parser
+#define SOURCE_RING_SLOTS 4
+
+// Most bytes read ahead of a source to recognise the format
+#define SOURCE_HEAD_MAX 16
+
+// A producer of chunks. Chunks are NUL terminated one byte
+// past 'len' and writable, so the parser may split lines in place
+//
+struct chunk_source {
+  // Hand out the next chunk, giving back the previous one.
+  // Returns False at the end of input (and keeps doing so)
+  int (*next)(chunk_source *src, char **data, size_t *len);
+  void (*close)(chunk_source *src);
+  // Read up to 'cap' bytes straight into 'buf' instead, for a
+  // source that reads on the caller's thread; NULL for the
+  // decompressors, whose own threads fill their chunks.
+  // Returns the bytes read, 0 at the end of input
+  size_t (*read)(chunk_source *src, char *buf, size_t cap);
+  // Set once the input turns out to be corrupt or unreadable
+  int error;
+};
+
+// Returns True if the 'len' bytes at 'magic' start a bzip2 stream
+//
+int source_is_bzip2(const unsigned char *magic, size_t len);
+
+// Read chunks from 'stream' on the calling thread, starting
+// with the 'head_len' bytes at 'head' already read from it
+//
+chunk_source *file_source_open(FILE *stream, const unsigned char *head, size_t head_len);
+
+// Decompress the bzip2 input 'fd', which may be a pipe, on a
+// dedicated thread into a ring of SOURCE_RING_SLOTS chunks,
+// starting with the 'head_len' bytes at 'head' already read from
+// it. Takes ownership of 'fd'
+//
+chunk_source *bzip2_source_open(int fd, const unsigned char *head, size_t head_len);
+
+// Decompress the bzip2 file 'fd' block by block on a pool of
+// 'threads' workers (0 for one per CPU), delivering blocks in
+// file order. 'fd' must be a regular file; returns NULL if it
+// is not, else takes ownership of 'fd'
+//
+chunk_source *pbzip2_source_open(int fd, int threads);
+
+#endif
@@ -0,0 +1,80 @@
+//========================================================//
+//  spsc.h                                                //
+//  Lock-free single-producer/single-consumer queue       //
+//                                                        //
+//  A fixed ring of N (a power of two) slots with the     //
+//  producer and consumer indices on separate cache       //
+//  lines. Used to hand chunks and batches between the    //
+//  stages of the simulation pipeline                     //
+//========================================================//
+
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <stdint.h>
+#include <sched.h>
+#include <atomic>
+#include <immintrin.h>
+
+#define SPSC_CACHE_LINE 64
+
+// Spins before a waiting stage starts yielding its CPU
+#define SPSC_SPINS 256
+
+template <typename T, uint32_t N>
+struct spsc_queue {
+  static_assert((N & (N - 1)) == 0, "spsc_queue size must be a power of two");
+
+  alignas(SPSC_CACHE_LINE) std::atomic<uint32_t> head; // next slot to write
+  alignas(SPSC_CACHE_LINE) std::atomic<uint32_t> tail; // next slot to read
+  alignas(SPSC_CACHE_LINE) T slots[N];
+
+  void init()
+  {
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+  }
+
+  // Producer side. Returns False if the queue is full
+  int push(const T &v)
+  {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == N)
+    {
+      return 0;
+    }
+    slots[h & (N - 1)] = v;
+    head.store(h + 1, std::memory_order_release);
+    return 1;
+  }
+
+  // Consumer side. Returns False if the queue is empty
+  int pop(T *v)
+  {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (head.load(std::memory_order_acquire) == t)
+    {
+      return 0;
+    }
+    *v = slots[t & (N - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return 1;
+  }
+};
+
+// Back off while waiting on a queue: spin briefly, then yield
+// so a stage sharing the core can make progress
+//
+static inline void spsc_backoff(int *spins)
+{
+  if (++*spins < SPSC_SPINS)
+  {
+    _mm_pause();
+  }
+  else
+  {
+    sched_yield();
+  }
+}
+
+#endif
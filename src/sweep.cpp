@@ -0,0 +1,358 @@
+//========================================================//
+//  sweep.cpp                                             //
+//  Source file for the parallel sweep runner             //
+//                                                        //
+//  Jobs are dealt round-robin onto per-worker deques.    //
+//  A worker takes its own jobs from the back and, once   //
+//  its deque is empty, steals from the front of the      //
+//  others, so long simulations do not leave the rest of  //
+//  the pool idle behind a static partition               //
+//========================================================//
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "sweep.h"
+
+void simulate_batch(Predictor *p, const branch_batch *b, sim_result *r, uint8_t *predictions)
+{
+  for (size_t i = 0; i < b->count; i++)
+  {
+    uint32_t pc = b->pc[i];
+    uint32_t target = b->target[i];
+    uint8_t flags = b->flags[i];
+    uint32_t outcome = (flags & TRACE_OUTCOME) ? TAKEN : NOTTAKEN;
+    uint32_t condition = (flags & TRACE_CONDITION) ? 1 : 0;
+    uint32_t call = (flags & TRACE_CALL) ? 1 : 0;
+    uint32_t ret = (flags & TRACE_RET) ? 1 : 0;
+    uint32_t direct = (flags & TRACE_DIRECT) ? 1 : 0;
+
+    if (condition == 1)
+    {
+      r->num_branches++;
+      // Make a prediction, compare with actual outcome and
+      // train the predictor
+      uint8_t prediction = p->predict(pc, target, direct);
+      if (prediction != outcome)
+      {
+        r->mispredictions++;
+      }
+      if (predictions != NULL)
+      {
+        predictions[i] = prediction;
+      }
+      p->train(pc, target, outcome, condition, call, ret, direct);
+    }
+    else
+    {
+      p->track(pc, target, call, ret, direct);
+    }
+  }
+}
+
+//------------------------------------//
+//         In-Memory Traces           //
+//------------------------------------//
+
+int sweep_load(sweep_trace *t, const char *path)
+{
+  trace_t reader;
+  memset(t, 0, sizeof(*t));
+  t->path = path;
+  if (!trace_open(&reader, path))
+  {
+    return 0;
+  }
+
+  size_t capacity = 0;
+  branch_batch *b = (branch_batch *)malloc(sizeof(branch_batch));
+  while (trace_read_batch(&reader, b) > 0)
+  {
+    if (t->num_batches == capacity)
+    {
+      capacity = capacity ? 2 * capacity : 256;
+      t->batches = (branch_batch **)realloc(t->batches, capacity * sizeof(branch_batch *));
+    }
+    t->batches[t->num_batches++] = b;
+    b = (branch_batch *)malloc(sizeof(branch_batch));
+  }
+  free(b);
+
+  int ok = !trace_failed(&reader);
+  t->stats = reader.stats;
+  trace_close(&reader);
+  return ok;
+}
+
+void sweep_free(sweep_trace *t)
+{
+  for (size_t i = 0; i < t->num_batches; i++)
+  {
+    free(t->batches[i]);
+  }
+  free(t->batches);
+  t->batches = NULL;
+  t->num_batches = 0;
+}
+
+//------------------------------------//
+//       Work-Stealing Scheduler      //
+//------------------------------------//
+
+// Jobs never spawn jobs, so a deque only shrinks and a plain
+// lock per deque is cheap next to a whole simulation
+struct sweep_deque {
+  pthread_mutex_t lock;
+  int *jobs;
+  int head; // next job to steal
+  int tail; // one past the next job to run locally
+};
+
+struct sweep_worker {
+  pthread_t thread;
+  int id;
+  struct sweep_pool *pool;
+};
+
+struct sweep_pool {
+  sweep_job *jobs;
+  int threads;
+  sweep_deque *deques;
+};
+
+static void sweep_run_indices(sweep_job *jobs, const int *indices, int num_jobs, int threads);
+
+// Take a job from the back of the worker's own deque, or steal
+// one from the front of another
+//
+// Returns the job index, or -1 once every deque is empty
+//
+static int sweep_take(sweep_pool *pool, int id)
+{
+  sweep_deque *own = &pool->deques[id];
+  pthread_mutex_lock(&own->lock);
+  if (own->head < own->tail)
+  {
+    int j = own->jobs[--own->tail];
+    pthread_mutex_unlock(&own->lock);
+    return j;
+  }
+  pthread_mutex_unlock(&own->lock);
+
+  for (int k = 1; k < pool->threads; k++)
+  {
+    sweep_deque *victim = &pool->deques[(id + k) % pool->threads];
+    pthread_mutex_lock(&victim->lock);
+    if (victim->head < victim->tail)
+    {
+      int j = victim->jobs[victim->head++];
+      pthread_mutex_unlock(&victim->lock);
+      return j;
+    }
+    pthread_mutex_unlock(&victim->lock);
+  }
+  return -1;
+}
+
+static void sweep_simulate(sweep_job *job)
+{
+  size_t end = job->trace->num_batches;
+  if (job->batch_limit != 0 && job->batch_limit < end)
+  {
+    end = job->batch_limit;
+  }
+  if (job->predictor == NULL)
+  {
+    job->predictor = create_predictor(&job->spec);
+    job->batches_done = 0;
+    memset(&job->result, 0, sizeof(job->result));
+  }
+  for (; job->batches_done < end; job->batches_done++)
+  {
+    simulate_batch(job->predictor, job->trace->batches[job->batches_done], &job->result, NULL);
+  }
+  if (job->batches_done == job->trace->num_batches)
+  {
+    job->predictor->format_stats(job->stats, sizeof(job->stats));
+    delete job->predictor;
+    job->predictor = NULL;
+  }
+}
+
+static void *sweep_worker_main(void *arg)
+{
+  sweep_worker *w = (sweep_worker *)arg;
+  int j;
+  while ((j = sweep_take(w->pool, w->id)) >= 0)
+  {
+    sweep_simulate(&w->pool->jobs[j]);
+  }
+  return NULL;
+}
+
+void sweep_run(sweep_job *jobs, int num_jobs, int threads)
+{
+  int *indices = (int *)malloc(num_jobs * sizeof(int));
+  for (int j = 0; j < num_jobs; j++)
+  {
+    indices[j] = j;
+  }
+  sweep_run_indices(jobs, indices, num_jobs, threads);
+  free(indices);
+}
+
+// Run the jobs at 'indices' into 'jobs' on the pool
+static void sweep_run_indices(sweep_job *jobs, const int *indices, int num_jobs, int threads)
+{
+  if (threads <= 0)
+  {
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if (threads > num_jobs)
+  {
+    threads = num_jobs;
+  }
+  if (threads < 1)
+  {
+    threads = 1;
+  }
+
+  sweep_pool pool;
+  pool.jobs = jobs;
+  pool.threads = threads;
+  pool.deques = (sweep_deque *)calloc(threads, sizeof(sweep_deque));
+  for (int i = 0; i < threads; i++)
+  {
+    pthread_mutex_init(&pool.deques[i].lock, NULL);
+    pool.deques[i].jobs = (int *)malloc((num_jobs / threads + 1) * sizeof(int));
+  }
+  for (int j = 0; j < num_jobs; j++)
+  {
+    sweep_deque *d = &pool.deques[j % threads];
+    d->jobs[d->tail++] = indices[j];
+  }
+
+  // The calling thread works as worker 0. Workers that cannot be
+  // started leave their jobs to be stolen
+  sweep_worker *workers = (sweep_worker *)calloc(threads, sizeof(sweep_worker));
+  int started = 1;
+  for (int i = 0; i < threads; i++)
+  {
+    workers[i].id = i;
+    workers[i].pool = &pool;
+  }
+  for (int i = 1; i < threads; i++)
+  {
+    if (pthread_create(&workers[i].thread, NULL, sweep_worker_main, &workers[i]) != 0)
+    {
+      break;
+    }
+    started++;
+  }
+  sweep_worker_main(&workers[0]);
+  for (int i = 1; i < started; i++)
+  {
+    pthread_join(workers[i].thread, NULL);
+  }
+
+  for (int i = 0; i < threads; i++)
+  {
+    pthread_mutex_destroy(&pool.deques[i].lock);
+    free(pool.deques[i].jobs);
+  }
+  free(pool.deques);
+  free(workers);
+}
+
+//------------------------------------//
+//        Successive Halving          //
+//------------------------------------//
+
+static double sweep_rate(const sweep_job *job)
+{
+  return job->result.num_branches ? (double)job->result.mispredictions / job->result.num_branches : 0;
+}
+
+void sweep_halving(sweep_job *jobs, int num_jobs, int threads, int eta)
+{
+  int *active = (int *)malloc(num_jobs * sizeof(int));
+  int *group = (int *)malloc(num_jobs * sizeof(int));
+  int num_active = num_jobs;
+  for (int j = 0; j < num_jobs; j++)
+  {
+    active[j] = j;
+  }
+
+  for (int rung = SWEEP_RUNGS - 1; rung >= 0; rung--)
+  {
+    double prefix = pow(eta, -rung);
+    for (int k = 0; k < num_active; k++)
+    {
+      sweep_job *job = &jobs[active[k]];
+      size_t limit = (size_t)ceil(job->trace->num_batches * prefix);
+      job->batch_limit = rung == 0 ? 0 : (limit > 0 ? limit : 1);
+    }
+    sweep_run_indices(jobs, active, num_active, threads);
+    if (rung == 0)
+    {
+      break;
+    }
+
+    // Jobs are only ranked against others on the same trace. On
+    // each, keep the best 1/eta, at least one
+    int kept = 0;
+    for (int k = 0; k < num_active; k++)
+    {
+      const sweep_trace *trace = jobs[active[k]].trace;
+      int first = 1;
+      for (int i = 0; i < k; i++)
+      {
+        first = first && jobs[active[i]].trace != trace;
+      }
+      if (!first)
+      {
+        continue;
+      }
+
+      int n = 0;
+      for (int i = k; i < num_active; i++)
+      {
+        if (jobs[active[i]].trace == trace)
+        {
+          group[n++] = active[i];
+        }
+      }
+      // Insertion sort by rate, stable so ties keep job order
+      for (int i = 1; i < n; i++)
+      {
+        int j = group[i];
+        int p = i;
+        for (; p > 0 && sweep_rate(&jobs[group[p - 1]]) > sweep_rate(&jobs[j]); p--)
+        {
+          group[p] = group[p - 1];
+        }
+        group[p] = j;
+      }
+      int keep = (n + eta - 1) / eta;
+      for (int i = keep; i < n; i++)
+      {
+        sweep_job *job = &jobs[group[i]];
+        job->stopped = 1;
+        delete job->predictor;
+        job->predictor = NULL;
+      }
+    }
+    for (int k = 0; k < num_active; k++)
+    {
+      if (!jobs[active[k]].stopped)
+      {
+        active[kept++] = active[k];
+      }
+    }
+    num_active = kept;
+  }
+
+  free(active);
+  free(group);
+}
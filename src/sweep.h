@@ -0,0 +1,74 @@
+//========================================================//
+//  sweep.h                                               //
+//  Header file for the parallel sweep runner             //
+//                                                        //
+//  Runs (trace, predictor) jobs on a pool of worker      //
+//  threads. Each trace is decoded once into memory and   //
+//  shared read-only by every job that simulates it       //
+//========================================================//
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "predictor.h"
+#include "trace.h"
+
+struct sim_result {
+  uint32_t num_branches;
+  uint32_t mispredictions;
+};
+
+// Run predictor 'p' over the records of 'b', counting its
+// conditional branches and mispredictions in 'r'. If 'predictions'
+// is not NULL the prediction for record i is stored at index i
+//
+void simulate_batch(Predictor *p, const branch_batch *b, sim_result *r, uint8_t *predictions);
+
+// A trace decoded into memory
+struct sweep_trace {
+  const char *path;
+  branch_batch **batches;
+  size_t num_batches;
+  parse_stats stats;
+};
+
+// Decode the whole trace at 'path' into 't'
+//
+// Returns True if Successful
+//
+int sweep_load(sweep_trace *t, const char *path);
+
+void sweep_free(sweep_trace *t);
+
+// A job, zeroed before its first run. It may be run a prefix of
+// its trace at a time, resuming where the last run stopped
+struct sweep_job {
+  const sweep_trace *trace;
+  predictor_spec spec;
+  sim_result result;
+  char stats[256];       // the predictor's format_stats() once finished
+
+  Predictor *predictor;  // live between runs of a prefix
+  size_t batches_done;
+  size_t batch_limit;    // batches to run up to, 0 for the whole trace
+  int stopped;           // dropped by sweep_halving before the end
+};
+
+// Run every job up to its batch limit on 'threads' worker threads
+// (-1 or 0 for one per online CPU). Workers start on their own
+// share of the jobs and steal from the others once it runs out
+//
+void sweep_run(sweep_job *jobs, int num_jobs, int threads);
+
+#define SWEEP_RUNGS 3 // prefixes run by sweep_halving, the last whole
+
+// Successive halving: run every job on the first 1/eta^2 of its
+// trace, keep the best 1/eta of the jobs on each trace and extend
+// them to 1/eta of it, then keep the best 1/eta again and finish
+// those. Dropped jobs are marked stopped and keep the results of
+// their prefix; finished jobs have exact results for the whole
+// trace
+//
+void sweep_halving(sweep_job *jobs, int num_jobs, int threads, int eta);
+
+#endif
@@ -0,0 +1,157 @@
+//========================================================//
+//  tage.cpp                                              //
+//  Source file for the TAGE predictor                    //
+//                                                        //
+//  Registry of the TAGE configurations compiled as       //
+//  specializations, the geometry checks for the generic  //
+//  fallback and the AVX2 tag match kernel                //
+//========================================================//
+#include <immintrin.h>
+#include "tage.h"
+
+//------------------------------------//
+//             Registry               //
+//------------------------------------//
+
+// Registered configurations are held to the storage budget when
+// they are compiled
+template <typename G>
+static Predictor *create_tage()
+{
+  static_assert(tage_storage_bits(G()) <= STORAGE_BUDGET_BITS, "TAGE configuration is over the storage budget");
+  return new TagePredictor<G>();
+}
+
+#define TAGE_VARIANT(name, G) {name, tage_runtime_geometry(G()), create_tage<G>}
+
+const tage_variant tage_variants[] = {
+  TAGE_VARIANT("tage64k", tage64k_geometry),
+  TAGE_VARIANT("tage64k-long", tage64k_long_geometry),
+};
+const int num_tage_variants = sizeof(tage_variants) / sizeof(tage_variants[0]);
+
+const tage_variant *find_tage_variant(const char *name)
+{
+  for (int i = 0; i < num_tage_variants; i++)
+  {
+    if (!strcmp(tage_variants[i].name, name))
+    {
+      return &tage_variants[i];
+    }
+  }
+  return NULL;
+}
+
+int tage_check_geometry(const tage_geometry *g)
+{
+  if (g->num_tables < 1 || g->num_tables > TAGE_MAX_TABLES)
+  {
+    fprintf(stderr, "TAGE needs 1 to %d tagged tables, not %d\n", TAGE_MAX_TABLES, g->num_tables);
+    return 0;
+  }
+  if (g->hist_len < 1 || g->hist_len > TAGE_MAX_HIST_LEN)
+  {
+    fprintf(stderr, "TAGE history of %d bits is outside the 1 to %d supported\n", g->hist_len, TAGE_MAX_HIST_LEN);
+    return 0;
+  }
+  if (g->base_bits < 1 || g->base_bits > 24 || g->table_bits < 1 || g->table_bits > 24)
+  {
+    fprintf(stderr, "TAGE tables need 1 to 24 index bits\n");
+    return 0;
+  }
+  if (g->tag_bits < 1 || g->tag_bits > 16)
+  {
+    fprintf(stderr, "TAGE tags need 1 to 16 bits, not %d\n", g->tag_bits);
+    return 0;
+  }
+  if (g->u_decay < 1)
+  {
+    fprintf(stderr, "TAGE useful bit decay period must be positive, not %d\n", g->u_decay);
+    return 0;
+  }
+  for (int i = 0; i < g->num_tables; i++)
+  {
+    if (g->table_hist_len[i] < 1 || g->table_hist_len[i] > g->hist_len)
+    {
+      fprintf(stderr, "TAGE table %d needs a history length of 1 to %d, not %d\n", i, g->hist_len,
+              g->table_hist_len[i]);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void tage_canonical_lengths(tage_geometry *g)
+{
+  for (int i = 0; i < g->num_tables; i++)
+  {
+    int len = g->table_hist_len[i];
+    int index_len = tage_fold_length(len, g->table_bits, g->hist_len);
+    int tag_len = tage_fold_length(len, g->tag_bits, g->hist_len);
+    int shortest = 1;
+    while (tage_fold_length(shortest, g->table_bits, g->hist_len) != index_len ||
+           tage_fold_length(shortest, g->tag_bits, g->hist_len) != tag_len)
+    {
+      shortest++;
+    }
+    g->table_hist_len[i] = shortest;
+  }
+}
+
+void tage_storage(const tage_geometry *g, storage_report *r)
+{
+  storage_add(r, (int64_t)2 << g->base_bits, "base predictor");
+  for (int i = 0; i < g->num_tables; i++)
+  {
+    storage_add(r, (int64_t)tage_kept_tag_bits(g->tag_bits) << g->table_bits, "table %d tags", i);
+    storage_add(r, (int64_t)3 << g->table_bits, "table %d counters", i);
+    storage_add(r, (int64_t)2 << g->table_bits, "table %d useful bits", i);
+  }
+  storage_add(r, g->hist_len, "global history");
+  storage_add(r, g->num_tables * (g->table_bits + g->tag_bits), "folded histories");
+  storage_add(r, storage_count_bits(g->u_decay), "useful decay counter");
+}
+
+Predictor *new_tage_predictor(const tage_geometry *g)
+{
+  if (!tage_check_geometry(g))
+  {
+    exit(1);
+  }
+
+  tage_geometry key = *g;
+  for (int i = key.num_tables; i < TAGE_MAX_TABLES; i++)
+  {
+    key.table_hist_len[i] = 0;
+  }
+  for (int i = 0; i < num_tage_variants; i++)
+  {
+    if (!memcmp(&tage_variants[i].geometry, &key, sizeof(key)))
+    {
+      return tage_variants[i].create();
+    }
+  }
+  return new TagePredictor<tage_geometry>(key);
+}
+
+//------------------------------------//
+//          AVX2 Tag Match            //
+//------------------------------------//
+
+// Gather the candidate tag of every table from the arena and
+// compare them all at once. Lanes past the last table are masked
+// off, and a gather reading a one byte tag as a dword stays inside
+// the arena as counters follow each tag array
+//
+__attribute__((target("avx2"))) uint32_t tage_match_avx2(const uint8_t *arena, const int32_t *tag_offset,
+                                                         const tage_context *ctx, int num_tables)
+{
+  const __m256i lanes = _mm256_cmpgt_epi32(_mm256_set1_epi32(num_tables), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  __m256i index = _mm256_maskload_epi32((const int *)ctx->index, lanes);
+  __m256i tag = _mm256_maskload_epi32((const int *)ctx->tag, lanes);
+  __m256i offset = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)tag_offset), index);
+  __m256i stored = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int *)arena, offset, lanes, 1);
+  stored = _mm256_and_si256(stored, _mm256_set1_epi32(0xFF));
+  __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi32(stored, tag), lanes);
+  return (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(eq));
+}
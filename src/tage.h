@@ -0,0 +1,508 @@
+//========================================================//
+//  tage.h                                                //
+//  Header file for the TAGE predictor                    //
+//                                                        //
+//  TagePredictor is a template over its geometry. The    //
+//  configurations we ship are structs of constants, so   //
+//  masks, loop bounds and fold widths are folded into    //
+//  their code; tage_geometry holds the same fields at    //
+//  run time for ad-hoc configurations                    //
+//========================================================//
+
+#ifndef TAGE_H
+#define TAGE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "predictor.h"
+
+#define TAGE_MAX_HIST_LEN 2048 // longest global history a TAGE can use
+#define TAGE_U_DECAY 256000    // default trains between halvings of the useful bits
+#define TAGE_KEPT_TAG_BITS 8   // low bits of each hashed tag a table stores and compares
+
+// Tag match kernels, picked at runtime
+#define TAGE_MATCH_SCALAR 0
+#define TAGE_MATCH_AVX2 1
+extern int tage_match_kernel;  // kernel to use if the CPU has it
+extern int tage_verify_simd;   // check every SIMD match against scalar
+
+//------------------------------------//
+//            Geometries              //
+//------------------------------------//
+
+// tage_geometry in predictor.h is the geometry chosen at run time.
+// Compile-time geometries declare the same names as static
+// constexpr members
+
+// Default geometry, about 47Kbit of state
+struct tage64k_geometry {
+  static constexpr int num_tables = 6;
+  static constexpr int hist_len = 32;
+  static constexpr int base_bits = 12;
+  static constexpr int table_bits = 9;
+  static constexpr int tag_bits = 13;
+  static constexpr int u_decay = TAGE_U_DECAY;
+  static constexpr int table_hist_len[TAGE_MAX_TABLES] = {1, 2, 4, 8, 16, 32};
+};
+
+// The default tables over geometric histories up to 640 bits
+struct tage64k_long_geometry {
+  static constexpr int num_tables = 6;
+  static constexpr int hist_len = 640;
+  static constexpr int base_bits = 12;
+  static constexpr int table_bits = 9;
+  static constexpr int tag_bits = 13;
+  static constexpr int u_decay = TAGE_U_DECAY;
+  static constexpr int table_hist_len[TAGE_MAX_TABLES] = {5, 15, 44, 130, 320, 640};
+};
+
+// Copy any geometry into a runtime one
+//
+template <typename G>
+tage_geometry tage_runtime_geometry(const G &g)
+{
+  tage_geometry r;
+  memset(&r, 0, sizeof(r));
+  r.num_tables = g.num_tables;
+  r.hist_len = g.hist_len;
+  r.base_bits = g.base_bits;
+  r.table_bits = g.table_bits;
+  r.tag_bits = g.tag_bits;
+  r.u_decay = g.u_decay;
+  for (int i = 0; i < g.num_tables; i++)
+  {
+    r.table_hist_len[i] = g.table_hist_len[i];
+  }
+  return r;
+}
+
+// Tag bits a table keeps of a 'tag_bits' wide hash
+//
+static constexpr int tage_kept_tag_bits(int tag_bits)
+{
+  return tag_bits < TAGE_KEPT_TAG_BITS ? tag_bits : TAGE_KEPT_TAG_BITS;
+}
+
+// Returns True if 'g' can be simulated, printing why not otherwise
+//
+int tage_check_geometry(const tage_geometry *g);
+
+// History bits hash() folds for a table of history length 'len'
+// into 'width' bits: whole chunks, no more than the 'hist_len'
+// bits the history holds
+//
+static inline int tage_fold_length(int len, int width, int hist_len)
+{
+  int length = (len + width - 1) / width * width;
+  return length < hist_len ? length : hist_len;
+}
+
+// Replace each history length of 'g' by the shortest one that folds
+// into the same index and tag bits, so geometries TAGE simulates
+// alike read alike
+//
+void tage_canonical_lengths(tage_geometry *g);
+
+// Modeled storage of geometry 'g' in bits: the base predictor,
+// every tagged table's kept tag bits, 3-bit counters and 2-bit
+// useful counters, the global history with its folded index and tag
+// copies, and the counter that times useful bit decay
+//
+template <typename G>
+constexpr int64_t tage_storage_bits(G g)
+{
+  return ((int64_t)2 << g.base_bits) +
+         g.num_tables * ((((int64_t)tage_kept_tag_bits(g.tag_bits) + 3 + 2) << g.table_bits) + g.table_bits + g.tag_bits) +
+         g.hist_len + storage_count_bits(g.u_decay);
+}
+
+// Fill 'r' with the structure by structure breakdown of
+// tage_storage_bits(*g)
+//
+void tage_storage(const tage_geometry *g, storage_report *r);
+
+//------------------------------------//
+//             Registry               //
+//------------------------------------//
+
+// A named configuration with its compile-time specialization
+struct tage_variant {
+  const char *name;
+  tage_geometry geometry;
+  Predictor *(*create)();
+};
+
+extern const tage_variant tage_variants[];
+extern const int num_tage_variants;
+
+// Returns the registered configuration called 'name', or NULL
+//
+const tage_variant *find_tage_variant(const char *name);
+
+// Create a TAGE of geometry 'g', specialized if a registered
+// configuration has the same geometry and generic otherwise
+//
+Predictor *new_tage_predictor(const tage_geometry *g);
+
+//------------------------------------//
+//          Table Storage             //
+//------------------------------------//
+
+#define TAGE_ARENA_ALIGN 64
+
+// A tagged table as structure-of-arrays in the predictor's arena.
+// Tags take one byte each, 3-bit counters are packed two to a
+// byte and 2-bit useful counters four to a byte
+struct tage_table {
+  uint8_t *tag;
+  uint8_t *ctr;
+  uint8_t *u;
+};
+
+static inline size_t tage_arena_align(size_t bytes)
+{
+  return (bytes + TAGE_ARENA_ALIGN - 1) & ~(size_t)(TAGE_ARENA_ALIGN - 1);
+}
+
+static inline uint8_t get_2bit(const uint8_t *a, uint32_t i)
+{
+  return (a[i >> 2] >> ((i & 3) * 2)) & 3;
+}
+
+static inline void set_2bit(uint8_t *a, uint32_t i, uint8_t v)
+{
+  int shift = (i & 3) * 2;
+  a[i >> 2] = (a[i >> 2] & ~(3 << shift)) | (v << shift);
+}
+
+static inline uint8_t get_ctr(const tage_table *t, uint32_t i)
+{
+  return (t->ctr[i >> 1] >> ((i & 1) * 4)) & 0xF;
+}
+
+static inline void set_ctr(tage_table *t, uint32_t i, uint8_t v)
+{
+  int shift = (i & 1) * 4;
+  t->ctr[i >> 1] = (t->ctr[i >> 1] & ~(0xF << shift)) | (v << shift);
+}
+
+// Everything the lookup of one branch found, so training reuses
+// it instead of hashing the history again. Tags are the kept
+// bits, as compared
+struct tage_context {
+  uint32_t index[TAGE_MAX_TABLES];
+  uint32_t tag[TAGE_MAX_TABLES];
+  uint8_t hit[TAGE_MAX_TABLES];
+  uint8_t ctr[TAGE_MAX_TABLES];
+  uint32_t base_index;
+  uint8_t base_pred;
+  int provider;     // longest hitting table, -1 for the base predictor
+  int alt;          // next hitting table, -1 for the base predictor
+  uint8_t provider_pred;
+  uint8_t alt_pred;
+};
+
+// Hit mask of the candidate tags in 'ctx' against the tag arrays
+// at 'tag_offset' bytes into 'arena', bit i set if table i matched
+//
+uint32_t tage_match_avx2(const uint8_t *arena, const int32_t *tag_offset, const tage_context *ctx, int num_tables);
+
+//------------------------------------//
+//            Predictor               //
+//------------------------------------//
+
+template <typename G>
+class TagePredictor : public Predictor
+{
+public:
+  TagePredictor(const G &geometry = G());
+  ~TagePredictor();
+  uint8_t predict(uint32_t pc, uint32_t target, uint32_t direct);
+  void train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct);
+  void storage(storage_report *r);
+
+  // Look up the branch at 'pc', filling 'ctx'
+  //
+  // Returns the prediction
+  //
+  uint8_t lookup(uint32_t pc, tage_context *ctx);
+
+  // Update the tables from the lookup 'ctx' of the branch at
+  // 'pc', then push 'outcome' into the history
+  //
+  void update(uint32_t pc, uint32_t outcome, const tage_context *ctx);
+
+private:
+  uint32_t tage_index(uint32_t pc, int table_num);
+  uint32_t tage_tag(uint32_t pc, int table_num);
+  uint32_t match_scalar(const tage_context *ctx);
+
+  int fold_length(int len, int width)
+  {
+    return tage_fold_length(len, width, geom.hist_len);
+  }
+
+  G geom;
+
+  global_history<TAGE_MAX_HIST_LEN> tage_ghistory;
+  folded_history index_fold[TAGE_MAX_TABLES];
+  folded_history tag_fold[TAGE_MAX_TABLES];
+  uint8_t *tage_arena;           // every table below, 64-byte aligned
+  uint8_t *tage_base_pred_table; // 2-bit counters, four to a byte
+  tage_table tage_tables[TAGE_MAX_TABLES];
+  int tage_counter;
+
+  // tag match kernel, and for AVX2 each table's tag array as an
+  // offset into the arena
+  int match_kernel;
+  int32_t tag_offset[TAGE_MAX_TABLES];
+
+  // lookup of the last predict(), used by train()
+  tage_context ctx;
+};
+
+template <typename G>
+uint32_t TagePredictor<G>::tage_index(uint32_t pc, int table_num){
+  uint32_t index_bits = geom.table_bits;
+  uint32_t mask = (1 << index_bits) - 1;
+  //PC^hashed history
+  uint32_t pc_index = ((pc>>2)^table_num)&mask; //ignore L2SBs
+  uint32_t hist_index = index_fold[table_num].comp;
+  return (pc_index^hist_index)&mask;
+}
+
+template <typename G>
+uint32_t TagePredictor<G>::tage_tag(uint32_t pc, int table_num)
+{
+  uint32_t mask = (1<<geom.tag_bits)-1;
+
+  uint32_t pc_tag = ((pc >> (2 + geom.table_bits))^table_num) & mask;
+  uint32_t hist_tag = tag_fold[table_num].comp;
+
+  //hash at the full width, keep the low bits
+  return ((pc_tag ^ hist_tag) & ((1<<tage_kept_tag_bits(geom.tag_bits))-1));
+}
+
+template <typename G>
+TagePredictor<G>::TagePredictor(const G &geometry)
+  : geom(geometry)
+{
+  //lay the base predictor and every table's tags, counters and
+  //useful bits out in one arena, each array on its own cache lines
+  uint32_t base_entries = 1<<geom.base_bits;
+  uint32_t table_entries = 1<<geom.table_bits;
+  size_t tag_bytes = table_entries;
+  size_t base_size = tage_arena_align((base_entries+3)/4);
+  size_t table_size = tage_arena_align(tag_bytes) + tage_arena_align((table_entries+1)/2) + tage_arena_align((table_entries+3)/4);
+  size_t arena_size = base_size + geom.num_tables*table_size;
+  if(posix_memalign((void **)&tage_arena, TAGE_ARENA_ALIGN, arena_size)!=0){
+    fprintf(stderr, "Unable to allocate %zu bytes of TAGE tables\n", arena_size);
+    exit(1);
+  }
+
+  uint8_t *p = tage_arena;
+  tage_base_pred_table = p;
+  p += base_size;
+  int i;
+  memset(tage_tables, 0, sizeof(tage_tables));
+  for(i=0;i<geom.num_tables;i++){
+    tage_table *t = &tage_tables[i];
+    t->tag = p;
+    p += tage_arena_align(tag_bytes);
+    t->ctr = p;
+    p += tage_arena_align((table_entries+1)/2);
+    t->u = p;
+    p += tage_arena_align((table_entries+3)/4);
+  }
+
+  //init base predictor to weakly not taken, counters to TNN, tags
+  //and useful bits to 0
+  memset(tage_base_pred_table, WN*0x55, base_size);
+  for(i=0;i<geom.num_tables;i++){
+    memset(tage_tables[i].ctr, TNN*0x11, (table_entries+1)/2);
+    memset(tage_tables[i].u, 0, (table_entries+3)/4);
+    memset(tage_tables[i].tag, 0, tag_bytes);
+  }
+
+  match_kernel=tage_match_kernel;
+  if(match_kernel==TAGE_MATCH_AVX2 && !__builtin_cpu_supports("avx2"))
+    match_kernel=TAGE_MATCH_SCALAR;
+  memset(tag_offset, 0, sizeof(tag_offset));
+  for(i=0;i<geom.num_tables;i++){
+    tag_offset[i]=tage_tables[i].tag-tage_arena;
+  }
+
+  tage_ghistory.clear();
+  memset(index_fold, 0, sizeof(index_fold));
+  memset(tag_fold, 0, sizeof(tag_fold));
+  for(i=0;i<geom.num_tables;i++){
+    folded_init(&index_fold[i], fold_length(geom.table_hist_len[i], geom.table_bits), geom.table_bits);
+    folded_init(&tag_fold[i], fold_length(geom.table_hist_len[i], geom.tag_bits), geom.tag_bits);
+  }
+  tage_counter=0;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.provider=-1;
+  ctx.alt=-1;
+}
+
+template <typename G>
+TagePredictor<G>::~TagePredictor(){
+  free(tage_arena);
+}
+
+template <typename G>
+void TagePredictor<G>::storage(storage_report *r){
+  tage_geometry g = tage_runtime_geometry(geom);
+  tage_storage(&g, r);
+}
+
+template <typename G>
+uint8_t TagePredictor<G>::predict(uint32_t pc, uint32_t target, uint32_t direct){
+  return lookup(pc, &ctx);
+}
+
+template <typename G>
+void TagePredictor<G>::train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct){
+  update(pc, outcome, &ctx);
+}
+
+template <typename G>
+uint32_t TagePredictor<G>::match_scalar(const tage_context *ctx){
+  uint32_t hits=0;
+  for(int i=0;i<geom.num_tables;i++){
+    hits|=(uint32_t)(tage_tables[i].tag[ctx->index[i]]==ctx->tag[i])<<i;
+  }
+  return hits;
+}
+
+template <typename G>
+uint8_t TagePredictor<G>::lookup(uint32_t pc, tage_context *ctx){
+  ctx->base_index = ((pc>>2) & ((1<<geom.base_bits)-1));
+  SatCounter<2> base={get_2bit(tage_base_pred_table, ctx->base_index)};
+  ctx->base_pred=base.predict();
+
+  int i;
+  for(i=0;i<geom.num_tables;i++)
+  {
+    uint32_t table_index=tage_index(pc, i);
+    uint8_t pc_tag=tage_tag(pc, i);
+    ctx->index[i]=table_index;
+    ctx->tag[i]=pc_tag;
+    ctx->ctr[i]=get_ctr(&tage_tables[i], table_index);
+  }
+
+  //bit i of 'hits' is set if table i matched. The provider is the
+  //longest history hit and the alternate the next longest
+  uint32_t hits;
+  if(match_kernel==TAGE_MATCH_AVX2){
+    hits=tage_match_avx2(tage_arena, tag_offset, ctx, geom.num_tables);
+    if(tage_verify_simd && hits!=match_scalar(ctx)){
+      fprintf(stderr, "AVX2 TAGE tag match differs from scalar at pc 0x%x\n", pc);
+      exit(1);
+    }
+  }
+  else{
+    hits=match_scalar(ctx);
+  }
+  for(i=0;i<geom.num_tables;i++){
+    ctx->hit[i]=(hits>>i)&1;
+  }
+  ctx->provider=hits ? 31-__builtin_clz(hits) : -1;
+  hits&=~(1U<<ctx->provider);
+  ctx->alt=hits ? 31-__builtin_clz(hits) : -1;
+
+  ctx->provider_pred=(ctx->provider>=0)?SatCounter<3>{ctx->ctr[ctx->provider]}.predict():ctx->base_pred;
+  ctx->alt_pred=(ctx->alt>=0)?SatCounter<3>{ctx->ctr[ctx->alt]}.predict():ctx->base_pred;
+  return ctx->provider_pred;
+}
+
+template <typename G>
+void TagePredictor<G>::update(uint32_t pc, uint32_t outcome, const tage_context *ctx){
+  int main_pred_table = ctx->provider;
+  uint32_t base_index = ctx->base_index;
+  uint32_t main_index = (main_pred_table >= 0) ? ctx->index[main_pred_table] : 0;
+  uint8_t main_pred = ctx->provider_pred;
+  uint8_t alt_pred = ctx->alt_pred;
+
+  //Tage counter update
+  if(main_pred_table>=0){
+    SatCounter<3> ctr={get_ctr(&tage_tables[main_pred_table], main_index)};
+    ctr.update(outcome);
+    set_ctr(&tage_tables[main_pred_table], main_index, ctr.value);
+  }
+  else{
+    SatCounter<2> base={get_2bit(tage_base_pred_table, base_index)};
+    base.update(outcome);
+    set_2bit(tage_base_pred_table, base_index, base.value);
+  }
+
+  //useful bits update, when only one of provider and alternate
+  //was right
+  if(main_pred_table>=0 && main_pred!=alt_pred){
+    SatCounter<2> u={get_2bit(tage_tables[main_pred_table].u, main_index)};
+    u.update(main_pred==outcome);
+    set_2bit(tage_tables[main_pred_table].u, main_index, u.value);
+  }
+
+  //allocate in new table if no main_pred found
+  if(main_pred != outcome)
+  {
+    int allocate_table=-1;
+
+    for(int i=geom.num_tables-1;i>=0;i--)
+    {
+      if(main_pred_table==-1 || i>main_pred_table){
+        if(get_2bit(tage_tables[i].u, ctx->index[i])==0){
+          allocate_table=i;
+          break;
+        }
+      }
+    }
+
+    if(allocate_table>=0){
+      uint32_t allocate_index = ctx->index[allocate_table];
+      uint8_t allocate_tag = ctx->tag[allocate_table];
+
+      tage_tables[allocate_table].tag[allocate_index] = allocate_tag;
+      set_ctr(&tage_tables[allocate_table], allocate_index, (outcome==TAKEN)? TNN:NTT);
+      set_2bit(tage_tables[allocate_table].u, allocate_index, 0);
+    }
+    else {
+      //decrease usefulness of the entry with mismatched tag
+      for (int i = main_pred_table + 1; i < geom.num_tables; i++) {
+         uint32_t temp_index = ctx->index[i];
+         SatCounter<2> u={get_2bit(tage_tables[i].u, temp_index)};
+         u.dec();
+         set_2bit(tage_tables[i].u, temp_index, u.value);
+      }
+    }
+
+  }
+  tage_counter++;
+
+  //reset to prevent stale entires
+  if(tage_counter==geom.u_decay){
+    for(int i=0;i<geom.num_tables;i++){
+      uint32_t u_bytes = ((1<<geom.table_bits)+3)/4;
+      for(uint32_t j=0;j<u_bytes;j++){
+        tage_tables[i].u[j]=(tage_tables[i].u[j] >> 1) & 0x55; //right shift each by one
+      }
+    }
+    tage_counter=0;
+  }
+
+  //the fold lengths and widths are constants for compile-time
+  //geometries, so each register update reduces to a few shifts
+  for(int i=0;i<geom.num_tables;i++){
+    int index_len=fold_length(geom.table_hist_len[i], geom.table_bits);
+    int tag_len=fold_length(geom.table_hist_len[i], geom.tag_bits);
+    index_fold[i].comp=folded_shift(index_fold[i].comp, tage_ghistory.bit(index_len-1), outcome,
+                                    index_len % geom.table_bits, geom.table_bits);
+    tag_fold[i].comp=folded_shift(tag_fold[i].comp, tage_ghistory.bit(tag_len-1), outcome,
+                                  tag_len % geom.tag_bits, geom.tag_bits);
+  }
+  tage_ghistory.push(outcome);
+}
+
+#endif
@@ -0,0 +1,192 @@
+//========================================================//
+//  tage_scl.cpp                                          //
+//  Source file for the TAGE-SC-L predictor               //
+//                                                        //
+//  The statistical corrector sums centered counters and  //
+//  trusts the sign of the sum over TAGE by how far it is //
+//  past an adaptive threshold, after the corrector of    //
+//  Seznec's TAGE-SC-L                                    //
+//========================================================//
+#include <string.h>
+#include "tage_scl.h"
+
+#define SC_MASK ((1 << SC_TABLE_BITS) - 1)
+#define SC_CENTER (1 << (SC_CTR_BITS - 1))
+
+static const int sc_global_hist[SC_NUM_GLOBAL] = {6, 12, SC_GLOBAL_HIST};
+static const int sc_local_hist[SC_NUM_LOCAL] = {6, SC_LOCAL_HIST};
+
+static int sc_clamp(int v, int bits)
+{
+  int max = (1 << (bits - 1)) - 1;
+  return v > max ? max : (v < -max - 1 ? -max - 1 : v);
+}
+
+StatCorrector::StatCorrector()
+{
+  for (int t = 0; t < SC_TABLES; t++)
+  {
+    for (int i = 0; i <= SC_MASK; i++)
+    {
+      tables[t][i].value = SC_CENTER;
+    }
+  }
+  ghist = 0;
+  memset(lhist, 0, sizeof(lhist));
+  imli = 0;
+  threshold = 2 * SC_TABLES;
+  tc = 0;
+  first_h = 0;
+  second_h = 0;
+}
+
+uint8_t StatCorrector::predict(uint32_t pc, uint8_t tage_pred, int conf, sc_context *ctx)
+{
+  uint32_t p = (pc >> 2) ^ (pc >> (2 + SC_TABLE_BITS));
+  uint16_t local = lhist[(pc >> 2) & ((1 << SC_LOCAL_BITS) - 1)];
+  int t = 0;
+
+  ctx->index[t++] = ((p << 1) | tage_pred) & SC_MASK;
+  ctx->index[t++] = ((p << 3) ^ (conf << 1) ^ tage_pred) & SC_MASK;
+  for (int i = 0; i < SC_NUM_GLOBAL; i++)
+  {
+    uint64_t h = ghist & ((1ULL << sc_global_hist[i]) - 1);
+    ctx->index[t++] = (p ^ hash(h, sc_global_hist[i], SC_TABLE_BITS) ^ (i << (SC_TABLE_BITS - 2))) & SC_MASK;
+  }
+  for (int i = 0; i < SC_NUM_LOCAL; i++)
+  {
+    uint64_t h = local & ((1 << sc_local_hist[i]) - 1);
+    ctx->index[t++] = (p ^ hash(h, sc_local_hist[i], SC_TABLE_BITS) ^ (i << (SC_TABLE_BITS - 1))) & SC_MASK;
+  }
+  ctx->index[t++] = (p ^ (imli << 3)) & SC_MASK;
+
+  int sum = 0;
+  for (int i = 0; i < SC_TABLES; i++)
+  {
+    sum += 2 * (tables[i][ctx->index[i]].value - SC_CENTER) + 1;
+  }
+  ctx->sum = sum;
+  ctx->conf = conf;
+  ctx->tage_pred = tage_pred;
+  ctx->sc_pred = sum >= 0 ? TAKEN : NOTTAKEN;
+
+  // Revert TAGE when the corrector disagrees, unless the sum is
+  // small next to a confident TAGE and the choosers say TAGE has
+  // been right in that case
+  int abs_sum = sum < 0 ? -sum : sum;
+  ctx->pred = tage_pred;
+  if (ctx->sc_pred != tage_pred)
+  {
+    ctx->pred = ctx->sc_pred;
+    if (conf == TAGE_CONF_HIGH)
+    {
+      if (abs_sum < threshold / 4)
+      {
+        ctx->pred = tage_pred;
+      }
+      else if (abs_sum < threshold / 2)
+      {
+        ctx->pred = second_h < 0 ? ctx->sc_pred : tage_pred;
+      }
+    }
+    else if (conf == TAGE_CONF_MED && abs_sum < threshold / 4)
+    {
+      ctx->pred = first_h < 0 ? ctx->sc_pred : tage_pred;
+    }
+  }
+  return ctx->pred;
+}
+
+void StatCorrector::update(uint32_t pc, uint32_t target, uint32_t outcome, const sc_context *ctx)
+{
+  int abs_sum = ctx->sum < 0 ? -ctx->sum : ctx->sum;
+
+  // choosers count up while TAGE is right where they decide
+  if (ctx->sc_pred != ctx->tage_pred)
+  {
+    int tage_right = ctx->tage_pred == outcome ? 1 : -1;
+    if (ctx->conf == TAGE_CONF_HIGH && abs_sum < threshold / 2 && abs_sum >= threshold / 4)
+    {
+      second_h = sc_clamp(second_h + tage_right, SC_CHOOSER_BITS);
+    }
+    if (ctx->conf == TAGE_CONF_MED && abs_sum < threshold / 4)
+    {
+      first_h = sc_clamp(first_h + tage_right, SC_CHOOSER_BITS);
+    }
+  }
+
+  // Train on mispredictions and sums short of the threshold, and
+  // move the threshold so both happen about as often
+  if (ctx->sc_pred != outcome || abs_sum < threshold)
+  {
+    for (int i = 0; i < SC_TABLES; i++)
+    {
+      tables[i][ctx->index[i]].update(outcome);
+    }
+    tc = sc_clamp(tc + (ctx->sc_pred != outcome ? 1 : -1), SC_TC_BITS);
+    if (tc == (1 << (SC_TC_BITS - 1)) - 1)
+    {
+      threshold += threshold < (1 << SC_THRESHOLD_BITS) - 1;
+      tc = 0;
+    }
+    else if (tc == -(1 << (SC_TC_BITS - 1)))
+    {
+      threshold -= threshold > 0;
+      tc = 0;
+    }
+  }
+
+  // The IMLI count is the run of taken backward branches
+  if (target < pc)
+  {
+    imli = outcome ? (imli < (1 << SC_IMLI_BITS) - 1 ? imli + 1 : imli) : 0;
+  }
+  ghist = (ghist << 1) | outcome;
+  uint16_t *local = &lhist[(pc >> 2) & ((1 << SC_LOCAL_BITS) - 1)];
+  *local = ((*local << 1) | outcome) & ((1 << SC_LOCAL_HIST) - 1);
+}
+
+void StatCorrector::storage(storage_report *r)
+{
+  storage_add(r, (int64_t)SC_NUM_BIAS * SC_CTR_BITS << SC_TABLE_BITS, "corrector bias tables");
+  storage_add(r, (int64_t)SC_NUM_GLOBAL * SC_CTR_BITS << SC_TABLE_BITS, "corrector global tables");
+  storage_add(r, (int64_t)SC_NUM_LOCAL * SC_CTR_BITS << SC_TABLE_BITS, "corrector local tables");
+  storage_add(r, (int64_t)SC_CTR_BITS << SC_TABLE_BITS, "corrector IMLI table");
+  storage_add(r, (int64_t)SC_LOCAL_HIST << SC_LOCAL_BITS, "corrector local histories");
+  storage_add(r, SC_GLOBAL_HIST + SC_IMLI_BITS, "corrector global history, IMLI");
+  storage_add(r, SC_THRESHOLD_BITS + SC_TC_BITS + 2 * SC_CHOOSER_BITS, "corrector threshold, choosers");
+}
+
+//------------------------------------//
+//            Predictor               //
+//------------------------------------//
+
+static_assert(tage_scl_storage_bits(tage_scl_geometry()) <= STORAGE_BUDGET_BITS,
+              "TAGE-SC-L is over the storage budget");
+
+void tage_scl_storage(const tage_geometry *g, storage_report *r)
+{
+  tage_storage(g, r);
+  StatCorrector::storage(r);
+  LoopPredictor::storage(r);
+}
+
+Predictor *new_tage_scl_predictor(const tage_geometry *g)
+{
+  if (!tage_check_geometry(g))
+  {
+    exit(1);
+  }
+
+  tage_geometry key = *g;
+  for (int i = key.num_tables; i < TAGE_MAX_TABLES; i++)
+  {
+    key.table_hist_len[i] = 0;
+  }
+  tage_geometry fixed = tage_runtime_geometry(tage_scl_geometry());
+  if (!memcmp(&fixed, &key, sizeof(key)))
+  {
+    return new TageSclPredictor<tage_scl_geometry>();
+  }
+  return new TageSclPredictor<tage_geometry>(key);
+}
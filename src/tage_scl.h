@@ -0,0 +1,177 @@
+//========================================================//
+//  tage_scl.h                                            //
+//  Header file for the TAGE-SC-L predictor               //
+//                                                        //
+//  TAGE followed by a statistical corrector, a GEHL      //
+//  style sum of small counter tables over global, local  //
+//  and IMLI histories that reverts TAGE on the weakly    //
+//  biased branches it gets wrong, and a loop predictor   //
+//  that overrides both on loops of constant trip count   //
+//========================================================//
+
+#ifndef TAGE_SCL_H
+#define TAGE_SCL_H
+
+#include "tage.h"
+#include "loop.h"
+
+//------------------------------------//
+//       Statistical Corrector        //
+//------------------------------------//
+
+#define SC_TABLE_BITS 8     // log2 entries of each table
+#define SC_CTR_BITS 6
+#define SC_NUM_BIAS 2       // indexed by pc and the TAGE prediction
+#define SC_NUM_GLOBAL 3     // indexed by pc and global history
+#define SC_NUM_LOCAL 2      // indexed by pc and local history
+#define SC_TABLES (SC_NUM_BIAS + SC_NUM_GLOBAL + SC_NUM_LOCAL + 1) // and one by the IMLI count
+#define SC_GLOBAL_HIST 24   // longest global history
+#define SC_LOCAL_BITS 6     // log2 local histories
+#define SC_LOCAL_HIST 11    // local history bits
+#define SC_IMLI_BITS 8
+#define SC_THRESHOLD_BITS 8
+#define SC_TC_BITS 6        // threshold adaptation counter
+#define SC_CHOOSER_BITS 7
+
+// TAGE confidence, from its provider's counter
+#define TAGE_CONF_LOW 0
+#define TAGE_CONF_MED 1
+#define TAGE_CONF_HIGH 2
+
+// What the corrector computed for one branch, for its update
+struct sc_context {
+  uint32_t index[SC_TABLES];
+  int sum;
+  int conf;
+  uint8_t tage_pred;
+  uint8_t sc_pred;  // sign of the sum
+  uint8_t pred;     // TAGE or the corrector, whichever was chosen
+};
+
+class StatCorrector
+{
+public:
+  StatCorrector();
+
+  // Returns the prediction for the branch at 'pc' given TAGE's
+  // prediction 'tage_pred' of confidence 'conf', filling 'ctx'
+  //
+  uint8_t predict(uint32_t pc, uint8_t tage_pred, int conf, sc_context *ctx);
+
+  // Train on 'outcome' and push it into the histories
+  //
+  void update(uint32_t pc, uint32_t target, uint32_t outcome, const sc_context *ctx);
+
+  static void storage(storage_report *r);
+
+  static constexpr int64_t storage_bits = ((int64_t)SC_TABLES * SC_CTR_BITS << SC_TABLE_BITS) +
+                                          ((int64_t)SC_LOCAL_HIST << SC_LOCAL_BITS) + SC_GLOBAL_HIST + SC_IMLI_BITS +
+                                          SC_THRESHOLD_BITS + SC_TC_BITS + 2 * SC_CHOOSER_BITS;
+
+private:
+  SatCounter<SC_CTR_BITS> tables[SC_TABLES][1 << SC_TABLE_BITS];
+  uint64_t ghist;
+  uint16_t lhist[1 << SC_LOCAL_BITS];
+  int imli;         // iterations of the innermost loop so far
+  int threshold;    // sums below it are not trusted, and train
+  int tc;
+  int first_h;      // corrector against medium confidence TAGE
+  int second_h;     // corrector against high confidence TAGE
+};
+
+//------------------------------------//
+//            Predictor               //
+//------------------------------------//
+
+// TAGE geometry of the default TAGE-SC-L: the default tables over
+// histories twice as long, with tags hashed straight to the 8 bits
+// a table keeps rather than folded wider and truncated
+struct tage_scl_geometry {
+  static constexpr int num_tables = 6;
+  static constexpr int hist_len = 64;
+  static constexpr int base_bits = 12;
+  static constexpr int table_bits = 9;
+  static constexpr int tag_bits = 8;
+  static constexpr int u_decay = TAGE_U_DECAY;
+  static constexpr int table_hist_len[TAGE_MAX_TABLES] = {2, 4, 8, 16, 32, 64};
+};
+
+template <typename G>
+constexpr int64_t tage_scl_storage_bits(G g)
+{
+  return tage_storage_bits(g) + StatCorrector::storage_bits + LoopPredictor::storage_bits;
+}
+
+// Fill 'r' with the storage of a TAGE-SC-L over TAGE geometry 'g'
+//
+void tage_scl_storage(const tage_geometry *g, storage_report *r);
+
+// Create a TAGE-SC-L over TAGE geometry 'g', specialized if it is
+// the default one and generic otherwise
+//
+Predictor *new_tage_scl_predictor(const tage_geometry *g);
+
+// Confidence of the TAGE lookup 'ctx'
+//
+static inline int tage_confidence(const tage_context *ctx)
+{
+  if (ctx->provider < 0)
+  {
+    return TAGE_CONF_MED;
+  }
+  uint8_t ctr = ctx->ctr[ctx->provider];
+  if (ctr == 0 || ctr == SatCounter<3>::max)
+  {
+    return TAGE_CONF_HIGH;
+  }
+  return (ctr == 1 || ctr == SatCounter<3>::max - 1) ? TAGE_CONF_MED : TAGE_CONF_LOW;
+}
+
+template <typename G>
+class TageSclPredictor : public Predictor
+{
+public:
+  TageSclPredictor(const G &geometry = G())
+    : tage(geometry)
+  {
+  }
+
+  uint8_t predict(uint32_t pc, uint32_t target, uint32_t direct)
+  {
+    uint8_t tage_pred = tage.lookup(pc, &tage_ctx);
+    uint8_t sc_pred = sc.predict(pc, tage_pred, tage_confidence(&tage_ctx), &sc_ctx);
+    loop.lookup(pc, &loop_ctx);
+    return loop.predict(&loop_ctx, sc_pred);
+  }
+
+  void train(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct)
+  {
+    loop.update(&loop_ctx, outcome, sc_ctx.pred);
+    sc.update(pc, target, outcome, &sc_ctx);
+    tage.update(pc, outcome, &tage_ctx);
+  }
+
+  void storage(storage_report *r)
+  {
+    tage.storage(r);
+    StatCorrector::storage(r);
+    LoopPredictor::storage(r);
+  }
+
+  void format_stats(char *buf, size_t size)
+  {
+    loop.format_stats(buf, size);
+  }
+
+private:
+  TagePredictor<G> tage;
+  StatCorrector sc;
+  LoopPredictor loop;
+
+  // lookups of the last predict(), used by train()
+  tage_context tage_ctx;
+  sc_context sc_ctx;
+  loop_context loop_ctx;
+};
+
+#endif
@@ -0,0 +1,327 @@
+//========================================================//
+//  trace.cpp                                             //
+//  Source file for the branch trace reader               //
+//                                                        //
+//  Reads the text traces produced by the branch          //
+//  extractor and the binary traces written by            //
+//  trace_convert()                                       //
+//========================================================//
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
+
+uint8_t trace_pack_flags(uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct)
+{
+  return (outcome ? TRACE_OUTCOME : 0) |
+         (condition ? TRACE_CONDITION : 0) |
+         (call ? TRACE_CALL : 0) |
+         (ret ? TRACE_RET : 0) |
+         (direct ? TRACE_DIRECT : 0);
+}
+
+// Map 'fd' and check it holds a well formed binary trace
+//
+// Returns True if Successful
+//
+static int trace_map_binary(trace_t *t, int fd, size_t size)
+{
+  if (size < sizeof(trace_header))
+  {
+    fprintf(stderr, "Malformed binary trace header\n");
+    return 0;
+  }
+  void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED)
+  {
+    return 0;
+  }
+
+  const trace_header *hdr = (const trace_header *)map;
+  uint64_t body = size - sizeof(trace_header);
+  if (hdr->version != TRACE_VERSION || hdr->record_size != sizeof(trace_record) ||
+      hdr->num_records > body / sizeof(trace_record))
+  {
+    fprintf(stderr, "Malformed binary trace header\n");
+    munmap(map, size);
+    return 0;
+  }
+  madvise(map, size, MADV_SEQUENTIAL);
+
+  t->format = TRACE_BINARY;
+  t->map = map;
+  t->map_len = size;
+  t->records = (const trace_record *)((const char *)map + sizeof(trace_header));
+  t->num_records = hdr->num_records;
+  t->next = 0;
+  return 1;
+}
+
+int trace_open(trace_t *t, const char *path)
+{
+  memset(t, 0, sizeof(*t));
+  t->format = TRACE_TEXT;
+  parse_select(PARSE_BEST);
+
+  int fd = path == NULL || !strcmp(path, "-") ? STDIN_FILENO : open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    return 0;
+  }
+
+  // Pick the format from the magic at the start of the input. It
+  // is read, not peeked at, so pipes work too, and handed on to
+  // the source picked
+  static_assert(TRACE_MAGIC_LEN <= SOURCE_HEAD_MAX, "trace magic is longer than a source takes back");
+  unsigned char magic[TRACE_MAGIC_LEN];
+  size_t n = 0;
+  while (n < sizeof(magic))
+  {
+    ssize_t r = read(fd, magic + n, sizeof(magic) - n);
+    if (r < 0)
+    {
+      close(fd);
+      return 0;
+    }
+    if (r == 0)
+    {
+      break;
+    }
+    n += r;
+  }
+  struct stat st;
+  int regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+
+  if (n == sizeof(magic) && !memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_LEN))
+  {
+    // Binary traces are mapped
+    int ok = 0;
+    if (!regular)
+    {
+      fprintf(stderr, "Binary traces must be regular files\n");
+    }
+    else
+    {
+      ok = trace_map_binary(t, fd, st.st_size);
+    }
+    close(fd);
+    return ok;
+  }
+
+  if (source_is_bzip2(magic, n))
+  {
+    // Regular files are split into blocks and decoded in
+    // parallel, pipes are decoded as a single stream
+    t->source = regular ? pbzip2_source_open(fd, 0) : NULL;
+    if (t->source == NULL)
+    {
+      t->source = bzip2_source_open(fd, magic, n);
+    }
+  }
+  else
+  {
+    FILE *stream = fdopen(fd, "r");
+    t->source = stream != NULL ? file_source_open(stream, magic, n) : NULL;
+  }
+  if (t->source == NULL)
+  {
+    close(fd);
+    return 0;
+  }
+  return 1;
+}
+
+// Append 'n' bytes to the partial line kept in 'buf'
+//
+static void trace_stash(trace_t *t, const char *data, size_t n)
+{
+  if (t->carry + n + PARSE_PAD > t->len)
+  {
+    t->len = 2 * (t->carry + n + PARSE_PAD);
+    t->buf = (char *)realloc(t->buf, t->len);
+  }
+  memcpy(t->buf + t->carry, data, n);
+  t->carry += n;
+}
+
+// Parse the partial line kept in 'buf', now complete
+//
+static void trace_parse_stash(trace_t *t, branch_batch *b)
+{
+  const char *line = t->buf;
+  parse_lines(&line, t->buf + t->carry, b, &t->stats);
+  t->carry = 0;
+}
+
+// Append records of a text trace to 'b' until it is full or
+// the input ends
+//
+static void trace_fill(trace_t *t, branch_batch *b)
+{
+  while (b->count < TRACE_BATCH)
+  {
+    if (t->pos < t->end)
+    {
+      if (t->carry > 0)
+      {
+        // Finish the line started at the end of the last chunk
+        const char *nl = (const char *)memchr(t->pos, '\n', t->end - t->pos);
+        const char *stop = nl != NULL ? nl + 1 : t->end;
+        trace_stash(t, t->pos, stop - t->pos);
+        t->pos = stop;
+        if (nl != NULL)
+        {
+          trace_parse_stash(t, b);
+        }
+        continue;
+      }
+
+      parse_lines(&t->pos, t->end, b, &t->stats);
+      if (b->count < TRACE_BATCH && t->pos < t->end)
+      {
+        // The chunk ends inside a line
+        trace_stash(t, t->pos, t->end - t->pos);
+        t->pos = t->end;
+      }
+      continue;
+    }
+
+    char *data;
+    size_t len;
+    if (!t->source->next(t->source, &data, &len))
+    {
+      if (t->carry == 0)
+      {
+        return;
+      }
+      // The last line may lack its newline
+      trace_stash(t, "\n", 1);
+      trace_parse_stash(t, b);
+      continue;
+    }
+    t->pos = data;
+    t->end = data + len;
+  }
+}
+
+const trace_record *trace_next(trace_t *t)
+{
+  if (t->format == TRACE_BINARY)
+  {
+    if (t->next >= t->num_records)
+    {
+      return NULL;
+    }
+    return &t->records[t->next++];
+  }
+
+  if (t->batch_pos == t->batch.count)
+  {
+    t->batch.count = 0;
+    t->batch_pos = 0;
+    trace_fill(t, &t->batch);
+    if (t->batch.count == 0)
+    {
+      return NULL;
+    }
+  }
+  size_t i = t->batch_pos++;
+  t->scratch.pc = t->batch.pc[i];
+  t->scratch.target = t->batch.target[i];
+  t->scratch.flags = t->batch.flags[i];
+  return &t->scratch;
+}
+
+size_t trace_read_batch(trace_t *t, branch_batch *b)
+{
+  b->count = 0;
+  if (t->format == TRACE_BINARY)
+  {
+    uint64_t left = t->num_records - t->next;
+    size_t n = left < TRACE_BATCH ? left : TRACE_BATCH;
+    const trace_record *rec = &t->records[t->next];
+    for (size_t i = 0; i < n; i++)
+    {
+      b->pc[i] = rec[i].pc;
+      b->target[i] = rec[i].target;
+      b->flags[i] = rec[i].flags;
+    }
+    t->next += n;
+    b->count = n;
+    return n;
+  }
+
+  // Hand over what trace_next() left behind first
+  for (; t->batch_pos < t->batch.count; t->batch_pos++, b->count++)
+  {
+    b->pc[b->count] = t->batch.pc[t->batch_pos];
+    b->target[b->count] = t->batch.target[t->batch_pos];
+    b->flags[b->count] = t->batch.flags[t->batch_pos];
+  }
+  trace_fill(t, b);
+  return b->count;
+}
+
+void trace_close(trace_t *t)
+{
+  if (t->map != NULL)
+  {
+    munmap(t->map, t->map_len);
+  }
+  if (t->source != NULL)
+  {
+    t->source->close(t->source);
+  }
+  free(t->buf);
+  memset(t, 0, sizeof(*t));
+}
+
+int trace_failed(trace_t *t)
+{
+  return t->source != NULL && t->source->error;
+}
+
+int64_t trace_convert(trace_t *t, const char *path)
+{
+  FILE *out = fopen(path, "wb");
+  if (out == NULL)
+  {
+    return -1;
+  }
+
+  // The record count is patched in once the input is drained
+  trace_header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, TRACE_MAGIC, TRACE_MAGIC_LEN);
+  hdr.version = TRACE_VERSION;
+  hdr.record_size = sizeof(trace_record);
+  hdr.num_records = 0;
+  fwrite(&hdr, sizeof(hdr), 1, out);
+
+  branch_batch *b = (branch_batch *)malloc(sizeof(branch_batch));
+  trace_record *recs = (trace_record *)malloc(TRACE_BATCH * sizeof(trace_record));
+  size_t n;
+  while ((n = trace_read_batch(t, b)) > 0)
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      recs[i].pc = b->pc[i];
+      recs[i].target = b->target[i];
+      recs[i].flags = b->flags[i];
+    }
+    fwrite(recs, sizeof(trace_record), n, out);
+    hdr.num_records += n;
+  }
+  free(recs);
+  free(b);
+
+  int ok = !ferror(out) && fseek(out, 0, SEEK_SET) == 0 && fwrite(&hdr, sizeof(hdr), 1, out) == 1;
+  if (fclose(out) != 0 || !ok)
+  {
+    return -1;
+  }
+  return hdr.num_records;
+}
@@ -0,0 +1,136 @@
+//========================================================//
+//  trace.h                                               //
+//  Header file for the branch trace reader               //
+//                                                        //
+//  Traces come either as the tab-separated text written  //
+//  by the branch extractor (plain or bzip2 compressed)   //
+//  or as a compact binary file of fixed-width records,   //
+//  picked by the file magic                              //
+//========================================================//
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "source.h"
+#include "parse.h"
+
+//------------------------------------//
+//        Binary Trace Format         //
+//------------------------------------//
+
+// A binary trace starts with a trace_header followed by
+// num_records fixed-width trace_records, little endian
+#define TRACE_MAGIC "BPTRACE"
+#define TRACE_MAGIC_LEN 8
+#define TRACE_VERSION 1
+
+// Bits of trace_record.flags
+#define TRACE_OUTCOME   0x01
+#define TRACE_CONDITION 0x02
+#define TRACE_CALL      0x04
+#define TRACE_RET       0x08
+#define TRACE_DIRECT    0x10
+
+struct trace_header {
+  char magic[TRACE_MAGIC_LEN];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t num_records;
+};
+
+struct __attribute__((packed)) trace_record {
+  uint32_t pc;
+  uint32_t target;
+  uint8_t flags;
+};
+
+// Pack the per-branch flags into a trace_record flag byte
+//
+uint8_t trace_pack_flags(uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct);
+
+//------------------------------------//
+//          Record Batches            //
+//------------------------------------//
+
+// Number of records per batch
+#define TRACE_BATCH 4096
+
+// A batch of records laid out as structure-of-arrays, so the
+// simulator walks contiguous pc/target/flag arrays
+struct branch_batch {
+  uint32_t pc[TRACE_BATCH];
+  uint32_t target[TRACE_BATCH];
+  uint8_t flags[TRACE_BATCH];
+  size_t count;
+};
+
+//------------------------------------//
+//            Trace Reader            //
+//------------------------------------//
+
+#define TRACE_TEXT 0
+#define TRACE_BINARY 1
+
+struct trace_t {
+  int format;
+
+  // binary traces are mapped and walked in place
+  void *map;
+  size_t map_len;
+  const trace_record *records;
+  uint64_t num_records;
+  uint64_t next;
+
+  // text traces are parsed TRACE_BATCH lines at a time, with
+  // a line spanning two chunks assembled in 'buf'
+  chunk_source *source;
+  const char *pos;
+  const char *end;
+  char *buf;
+  size_t len;
+  size_t carry;
+  parse_stats stats;
+
+  // records parsed for trace_next()
+  branch_batch batch;
+  size_t batch_pos;
+  trace_record scratch;
+};
+
+// Open the trace at 'path' ("-" or NULL reads stdin). bzip2
+// compressed traces are decompressed in-process, in parallel when
+// 'path' is a regular file
+//
+// Returns True if Successful
+//
+int trace_open(trace_t *t, const char *path);
+
+// Return the next record of the trace, or NULL at the end.
+// For binary traces the record points into the mapping and
+// is valid until trace_close(), otherwise until the next call
+//
+const trace_record *trace_next(trace_t *t);
+
+// Fill 'b' with the next TRACE_BATCH records of the trace, fewer
+// only at its end
+//
+// Returns the number of records in 'b', 0 at the end
+//
+size_t trace_read_batch(trace_t *t, branch_batch *b);
+
+void trace_close(trace_t *t);
+
+// Returns True if the input turned out to be corrupt or unreadable
+//
+int trace_failed(trace_t *t);
+
+// Copy the remaining records of 't' into a binary trace at 'path'
+//
+// Returns the number of records written, or -1 on error
+//
+int64_t trace_convert(trace_t *t, const char *path);
+
+#endif